@@ -0,0 +1,143 @@
+// Yuval Anteby 212152896
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "Affinity.h"
+
+/**
+ * Leaves every role unpinned
+ * @param a pointer to the affinity settings
+*/
+void initAffinity(Affinity *a) {
+    for (int r = 0; r < NUM_ROLES; r++) {
+        a->isPinned[r] = 0;
+        CPU_ZERO(&a->cpus[r]);
+        a->nodeMask[r] = 0;
+    }
+}
+
+/**
+ * Parses a CPU list like "0-3,8,10-11", spaces are ignored
+ * @param text the list
+ * @param set filled with the CPUs of the list
+ * @return 0 on success, -1 if the list is invalid or empty
+*/
+int parseCpuList(const char *text, cpu_set_t *set) {
+    CPU_ZERO(set);
+    const char *p = text;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == ',') p++;
+        if (*p == '\0') break;
+
+        char *end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        p = end;
+        while (*p == ' ') p++;
+        if (*p == '-') {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+            p = end;
+        }
+        if (last >= CPU_SETSIZE) return -1;
+        for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, set);
+
+        while (*p == ' ') p++;
+        if (*p != '\0' && *p != ',') return -1;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+/**
+ * Returns the NUMA node of a CPU, from the nodeN entry sysfs keeps in its directory
+ * @return the node, or -1 if there is none (no NUMA support, or the CPU doesn't exist)
+*/
+static int nodeOfCpu(int cpu) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) return -1;
+    int node = -1;
+    struct dirent *entry;
+    while (node < 0 && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+            node = atoi(entry->d_name + 4);
+    }
+    closedir(dir);
+    return node;
+}
+
+/**
+ * Returns the NUMA nodes of a set of CPUs
+ * @param set the CPUs
+ * @return bit mask of their nodes, nodes from 64 up are left out, 0 if none is known
+*/
+unsigned long cpuNodeMask(const cpu_set_t *set) {
+    unsigned long mask = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, set)) continue;
+        int node = nodeOfCpu(cpu);
+        if (node >= 0 && node < 64) mask |= 1UL << node;
+    }
+    return mask;
+}
+
+/**
+ * Returns how many roles are pinned
+*/
+int pinnedRoles(const Affinity *a) {
+    int count = 0;
+    for (int r = 0; r < NUM_ROLES; r++) count += a->isPinned[r];
+    return count;
+}
+
+/**
+ * Initializes thread attributes that start a thread on the CPUs of the role,
+ * so it never runs (and never touches memory) anywhere else
+ * @param a the affinity settings
+ * @param role one of PipelineRole
+ * @param attr attributes to initialize, destroyed by the caller
+*/
+void initRoleAttr(const Affinity *a, int role, pthread_attr_t *attr) {
+    pthread_attr_init(attr);
+    if (!a->isPinned[role]) return;
+    if (pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &a->cpus[role]) != 0) {
+        printf("Failed to pin threads to the requested CPUs\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * Maps memory bound to a set of NUMA nodes. The policy is set before any
+ * page is touched, so it holds no matter which thread touches them, and
+ * every page is touched right away, so the faults aren't taken on the hot path.
+ * Without NUMA support in the kernel the memory is just mapped.
+ * @param size number of bytes
+ * @param nodeMask nodes the memory may be placed on
+ * @return zeroed memory, or NULL on failure
+*/
+void* allocOnNodes(size_t size, unsigned long nodeMask) {
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) return NULL;
+    // No libnuma, mbind is called directly. The kernel takes one bit less than maxnode
+    syscall(SYS_mbind, addr, size, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8 + 1, 0);
+    memset(addr, 0, size);
+    return addr;
+}
+
+/**
+ * Unmaps memory returned by allocOnNodes
+ * @param addr the memory, may be NULL
+ * @param size the size it was allocated with
+*/
+void freeOnNodes(void *addr, size_t size) {
+    if (addr) munmap(addr, size);
+}
@@ -0,0 +1,51 @@
+// Yuval Anteby 212152896
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+
+/**
+ * The kinds of threads in the pipeline, each one can be pinned to its own CPUs
+*/
+typedef enum PipelineRole {
+    ROLE_PRODUCER = 0,
+    ROLE_DISPATCHER,
+    ROLE_CO_EDITOR,
+    ROLE_SCREEN,
+    NUM_ROLES
+} PipelineRole;
+
+/**
+ * The CPUs every role runs on, roles that aren't pinned float freely
+*/
+typedef struct Affinity {
+    int isPinned[NUM_ROLES];
+    cpu_set_t cpus[NUM_ROLES];
+    unsigned long nodeMask[NUM_ROLES];  // NUMA nodes of those CPUs, 0 if unpinned or unknown
+} Affinity;
+
+// Leaves every role unpinned
+void initAffinity(Affinity *a);
+
+// Parses a CPU list like "0-3,8,10-11" into set
+int parseCpuList(const char *text, cpu_set_t *set);
+
+// Returns the NUMA nodes (below 64) of the CPUs of set as a bit mask, 0 if unknown
+unsigned long cpuNodeMask(const cpu_set_t *set);
+
+// Returns how many roles are pinned
+int pinnedRoles(const Affinity *a);
+
+// Initializes thread attributes that start a thread on the CPUs of the role
+void initRoleAttr(const Affinity *a, int role, pthread_attr_t *attr);
+
+// Maps zeroed, page aligned memory that is bound to the NUMA nodes of nodeMask
+void* allocOnNodes(size_t size, unsigned long nodeMask);
+
+// Unmaps memory returned by allocOnNodes
+void freeOnNodes(void *addr, size_t size);
+
+#endif
@@ -0,0 +1,138 @@
+// Yuval Anteby 212152896
+
+#include <string.h>
+#include <time.h>
+#include "Bench.h"
+
+/**
+ * Returns the monotonic clock in nanoseconds
+*/
+long long nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Clears the histogram
+ * @param h pointer to the histogram
+*/
+void initHistogram(LatencyHistogram *h) {
+    memset(h, 0, sizeof(LatencyHistogram));
+}
+
+/**
+ * Returns the bucket a latency falls into
+*/
+static int bucketOf(long long ns) {
+    if (ns < SUB_BUCKETS) return (int) ns;
+    int msb = 63 - __builtin_clzll((unsigned long long) ns);
+    int shift = msb - SUB_BUCKET_BITS;
+    int sub = (int) ((ns >> shift) & (SUB_BUCKETS - 1));
+    return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+/**
+ * Returns the middle of the values that fall into a bucket
+*/
+static long long bucketValue(int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    int shift = bucket / SUB_BUCKETS - 1;
+    long long low = (long long) (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + ((1LL << shift) >> 1);
+}
+
+/**
+ * Records a single latency
+ * @param h pointer to the histogram
+ * @param ns latency in nanoseconds
+*/
+void recordLatency(LatencyHistogram *h, long long ns) {
+    if (ns < 0) ns = 0;
+    h->counts[bucketOf(ns)]++;
+    h->total++;
+    if (ns > h->maxNs) h->maxNs = ns;
+}
+
+/**
+ * Returns the latency at the given percentile
+ * @param h pointer to the histogram
+ * @param percentile percentile between 0 and 100
+ * @return latency in nanoseconds, 0 if nothing was recorded
+*/
+long long latencyPercentile(const LatencyHistogram *h, double percentile) {
+    if (h->total == 0) return 0;
+    long long rank = (long long) (percentile / 100.0 * h->total);
+    if (rank >= h->total) rank = h->total - 1;
+
+    long long seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen > rank) {
+            long long value = bucketValue(i);
+            return value > h->maxNs ? h->maxNs : value;
+        }
+    }
+    return h->maxNs;
+}
+
+/**
+ * Prints one JSON line with the results of a benchmark run
+ * @param out where to print
+ * @param report the results
+*/
+void printBenchReport(FILE *out, const BenchReport *report) {
+    const LatencyHistogram *h = report->latencies;
+    double seconds = report->elapsedNs / 1e9;
+    fprintf(out, "{\"impl\":\"%s\",\"producers\":%d,\"dispatchers\":%d,\"messages\":%lld,"
+                 "\"pinned_roles\":%d,\"seconds\":%.6f,\"msgs_per_sec\":%.1f,\"steals\":%lld,",
+            BUFFER_IMPL, report->numOfProducers, report->numOfDispatchers, h->total,
+            report->pinnedRoles, seconds, seconds > 0 ? h->total / seconds : 0.0, report->steals);
+    fprintf(out, "\"latency_us\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,"
+                 "\"p999\":%.1f,\"max\":%.1f},",
+            latencyPercentile(h, 50) / 1e3, latencyPercentile(h, 90) / 1e3,
+            latencyPercentile(h, 99) / 1e3, latencyPercentile(h, 99.9) / 1e3,
+            h->maxNs / 1e3);
+
+    if (report->laneLatencies != NULL) {
+        fprintf(out, "\"lanes\":[");
+        for (int l = 0; l < report->numOfLanes; l++) {
+            const LatencyHistogram *lane = &report->laneLatencies[l];
+            fprintf(out, "%s{\"lane\":%d,\"messages\":%lld,\"p50\":%.1f,\"p99\":%.1f,"
+                         "\"p999\":%.1f,\"max\":%.1f}",
+                    l == 0 ? "" : ",", l, lane->total, latencyPercentile(lane, 50) / 1e3,
+                    latencyPercentile(lane, 99) / 1e3, latencyPercentile(lane, 99.9) / 1e3,
+                    lane->maxNs / 1e3);
+        }
+        fprintf(out, "],");
+    }
+
+    fprintf(out, "\"queues\":[");
+    for (int s = 0; s < report->numOfStages; s++) {
+        const BenchStage *stage = &report->stages[s];
+        long long capacity = 0, samples = 0, occupancySum = 0;
+        int maxOccupancy = 0;
+        for (int i = 0; i < stage->count; i++) {
+            BoundedBuffer *bb = stage->bufs[i];
+            capacity += bb->size;
+            samples += bb->occupancySamples;
+            occupancySum += bb->occupancySum;
+            if (bb->maxOccupancy > maxOccupancy) maxOccupancy = bb->maxOccupancy;
+        }
+        fprintf(out, "%s{\"stage\":\"%s\",\"buffers\":%d,\"capacity\":%lld,"
+                     "\"avg_occupancy\":%.2f,\"max_occupancy\":%d}",
+                s == 0 ? "" : ",", stage->name, stage->count, capacity,
+                samples > 0 ? (double) occupancySum / samples : 0.0, maxOccupancy);
+    }
+
+    fprintf(out, "],\"overflow\":[");
+    for (int c = 0; c < report->numOfCategories; c++) {
+        OverflowQueue *q = report->overflows[c];
+        fprintf(out, "%s{\"category\":\"%s\",\"policy\":\"%s\",\"routed\":%lld,"
+                     "\"overflowed\":%lld,\"dropped\":%lld,\"spilled\":%lld,\"max_depth\":%lld}",
+                c == 0 ? "" : ",", report->categoryNames[c], overflowPolicyName(q->policy),
+                q->routed, q->overflowed, q->dropped, q->spilled, q->maxDepth);
+    }
+    fprintf(out, "]}\n");
+    fflush(out);
+}
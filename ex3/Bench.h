@@ -0,0 +1,77 @@
+// Yuval Anteby 212152896
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include "BoundedBuffer.h"
+#include "Overflow.h"
+
+// Name of the BoundedBuffer implementation, reported with every result
+#ifndef BUFFER_IMPL
+#ifdef BUFFER_PACKED_LAYOUT
+#define BUFFER_IMPL "two-lock-packed"
+#else
+#define BUFFER_IMPL "two-lock-padded"
+#endif
+#endif
+
+// Latency histogram: every power of two is split into 2^SUB_BUCKET_BITS buckets
+#define SUB_BUCKET_BITS 4
+#define SUB_BUCKETS (1 << SUB_BUCKET_BITS)
+#define NUM_BUCKETS (64 * SUB_BUCKETS)
+
+/**
+ * Log-linear latency histogram, fixed size no matter how many
+ * messages are recorded, every bucket is within ~6% of its values
+*/
+typedef struct LatencyHistogram {
+    long long counts[NUM_BUCKETS];
+    long long total;
+    long long maxNs;
+} LatencyHistogram;
+
+/**
+ * A group of buffers that make up one stage of the pipeline
+*/
+typedef struct BenchStage {
+    const char *name;
+    BoundedBuffer **bufs;
+    int count;
+} BenchStage;
+
+/**
+ * Everything a benchmark run reports
+*/
+typedef struct BenchReport {
+    const LatencyHistogram *latencies;  // End to end latency of every message
+    const LatencyHistogram *laneLatencies; // Latency per priority lane, NULL with a single lane
+    int numOfLanes;
+    long long elapsedNs;                // From starting the pipeline until the screen got everything
+    int numOfProducers;
+    int numOfDispatchers;
+    long long steals;                   // Batches dispatchers took from other shards
+    int pinnedRoles;                    // How many thread roles were pinned to CPUs
+    const BenchStage *stages;           // Buffers of every stage, for the occupancy report
+    int numOfStages;
+    OverflowQueue **overflows;          // Overflow queue of every category
+    const char **categoryNames;
+    int numOfCategories;
+} BenchReport;
+
+// Returns the monotonic clock in nanoseconds
+long long nowNs(void);
+
+// Clears the histogram
+void initHistogram(LatencyHistogram *h);
+
+// Records a single latency
+void recordLatency(LatencyHistogram *h, long long ns);
+
+// Returns the latency at the given percentile (0-100)
+long long latencyPercentile(const LatencyHistogram *h, double percentile);
+
+// Prints one JSON line with the results of a benchmark run
+void printBenchReport(FILE *out, const BenchReport *report);
+
+#endif
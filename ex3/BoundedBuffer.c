@@ -1,6 +1,11 @@
 // Yuval Anteby 212152896
 
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
 #include "BoundedBuffer.h"
+#include "Affinity.h"
 
 /**
  * Initializes the buffer
@@ -9,78 +14,471 @@
  * @return pointer to the initialized buffer
 */
 BoundedBuffer* initBuffer(int bufferSize, int id) {
-    BoundedBuffer *bb = (BoundedBuffer*) malloc(sizeof(BoundedBuffer));
+    return initBufferOnNodes(bufferSize, id, 0);
+}
+
+/**
+ * Initializes a buffer whose memory is bound to a set of NUMA nodes,
+ * normally the nodes of the threads that remove from it
+ * @param bufferSize size of the buffer
+ * @param id id of the buffer
+ * @param nodeMask NUMA nodes of the memory, 0 to leave it to malloc
+ * @return pointer to the initialized buffer, or NULL on failure
+*/
+BoundedBuffer* initBufferOnNodes(int bufferSize, int id, unsigned long nodeMask) {
+    size_t laneBytes = sizeof(Message*) * bufferSize;
+    BoundedBuffer *bb;
+    if (nodeMask != 0) {
+        // The first lane shares the mapping, right after the struct (a whole number of cache lines)
+        bb = (BoundedBuffer*) allocOnNodes(sizeof(BoundedBuffer) + laneBytes, nodeMask);
+        if (bb == NULL) return NULL;
+        bb->lanes[0] = (Message**) (bb + 1);
+    } else {
+        // Aligned, so the producer and consumer sides really start on their own lines
+        bb = (BoundedBuffer*) aligned_alloc(CACHE_LINE_SIZE, sizeof(BoundedBuffer));
+        if (bb == NULL) return NULL;
+        memset(bb, 0, sizeof(BoundedBuffer));
+        bb->lanes[0] = (Message**) calloc(bufferSize, sizeof(Message*));
+        if (bb->lanes[0] == NULL) {
+            free(bb);
+            return NULL;
+        }
+    }
+    bb->nodeMask = nodeMask;
     bb->size = bufferSize;
-    bb->buffer = (char**) malloc(sizeof(char*) * bufferSize);
-    bb->head = 0;
-    bb->tail = 0;
     bb->id = id;
-    bb->isDone = 0;
+    bb->numOfLanes = 1;
+    bb->laneSchedule = LANES_STRICT;
+    atomic_init(&bb->isClosed, 0);
+
+    pthread_mutex_init(&bb->producerLock, NULL);
+    atomic_init(&bb->insertCount, 0);
+    bb->cachedRemoveCount = 0;
+    bb->occupancySum = 0;
+    bb->occupancySamples = 0;
+    bb->maxOccupancy = 0;
 
-    pthread_mutex_init(&bb->lock, NULL);
-    
+    pthread_mutex_init(&bb->consumerLock, NULL);
+    atomic_init(&bb->removeCount, 0);
+    bb->cachedInsertCount = 0;
+
+    // The semaphores count wake ups, not slots
+    sem_init(&bb->writeSemaphore, 0, 0);
+    atomic_init(&bb->sleepingProducers, 0);
     sem_init(&bb->readSemaphore, 0, 0);
-    sem_init(&bb->writeSemaphore, 0, bufferSize);
+    atomic_init(&bb->sleepingConsumers, 0);
 
     return bb; 
 }
 
+/**
+ * Splits the buffer into priority lanes. Must be called before any thread
+ * uses the buffer. Every lane can hold the whole capacity, the capacity
+ * itself stays size messages in total.
+ * @param bb pointer to the buffer
+ * @param numOfLanes number of lanes, 1 to MAX_PRIORITY_LANES
+ * @param schedule one of LaneSchedule
+ * @param weights messages in a row every lane gets with LANES_WEIGHTED, may be NULL for strict
+ * @return 0 on success, -1 on failure
+*/
+int setBufferLanes(BoundedBuffer *bb, int numOfLanes, int schedule, const int *weights) {
+    if (numOfLanes < 1 || numOfLanes > MAX_PRIORITY_LANES) return -1;
+    for (int lane = 1; lane < numOfLanes; lane++) {
+        if (bb->lanes[lane] != NULL) continue;
+        if (bb->nodeMask != 0)
+            bb->lanes[lane] = (Message**) allocOnNodes(sizeof(Message*) * bb->size, bb->nodeMask);
+        else
+            bb->lanes[lane] = (Message**) calloc(bb->size, sizeof(Message*));
+        if (bb->lanes[lane] == NULL) return -1;
+    }
+    bb->numOfLanes = numOfLanes;
+    bb->laneSchedule = schedule;
+    for (int lane = 0; lane < numOfLanes; lane++)
+        bb->laneWeights[lane] = weights != NULL && weights[lane] > 0 ? weights[lane] : 1;
+    bb->currentLane = 0;
+    bb->laneCredits = bb->laneWeights[0];
+    return 0;
+}
+
+/**
+ * Makes the buffer wake the sleepers of a signal. Must be called before any
+ * thread uses the buffer.
+ * @param bb pointer to the buffer
+ * @param signal the signal, NULL to stop signalling
+ * @param events SIGNAL_ON_* flags of what to signal
+*/
+void setBufferSignal(BoundedBuffer *bb, BufferSignal *signal, int events) {
+    bb->signal = signal;
+    bb->signalEvents = signal != NULL ? events : 0;
+}
+
+/**
+ * Parses a lane schedule
+ * @param text "strict" or "weighted" followed by the weight of every lane
+ *        from the lowest priority up, lanes without a weight get 1
+ * @param schedule set to one of LaneSchedule
+ * @param weights MAX_PRIORITY_LANES weights to fill
+ * @return 0 on success, -1 if the text is invalid
+*/
+int parseLaneSchedule(const char *text, int *schedule, int *weights) {
+    while (*text == ' ') text++;
+    for (int lane = 0; lane < MAX_PRIORITY_LANES; lane++) weights[lane] = 1;
+    if (strncmp(text, "strict", 6) == 0) {
+        *schedule = LANES_STRICT;
+        return 0;
+    }
+    if (strncmp(text, "weighted", 8) != 0) return -1;
+    *schedule = LANES_WEIGHTED;
+
+    const char *p = text + 8;
+    for (int lane = 0; lane < MAX_PRIORITY_LANES; lane++) {
+        char *end;
+        long weight = strtol(p, &end, 10);
+        if (end == p) break;
+        if (weight < 1 || weight > 1000000) return -1;
+        weights[lane] = (int) weight;
+        p = end;
+    }
+    while (*p == ' ') p++;
+    return *p == '\0' ? 0 : -1;
+}
+
+/**
+ * Returns whether a lane has a message, looking at the producer side
+ * only when the cached count says the lane is empty
+*/
+static int laneHasMessages(BoundedBuffer *bb, int lane) {
+    if (bb->laneRemoves[lane] < bb->cachedLaneInserts[lane]) return 1;
+    bb->cachedLaneInserts[lane] = atomic_load_explicit(&bb->laneInserts[lane], memory_order_acquire);
+    return bb->laneRemoves[lane] < bb->cachedLaneInserts[lane];
+}
+
+/**
+ * Chooses the lane of the next message, there must be at least one message.
+ * Every message counted in insertCount is counted in its lane as well, so
+ * when the higher lanes look empty the message is in lane 0.
+*/
+static int pickLane(BoundedBuffer *bb) {
+    if (bb->laneSchedule == LANES_STRICT) {
+        for (int lane = bb->numOfLanes - 1; lane > 0; lane--) {
+            if (laneHasMessages(bb, lane)) return lane;
+        }
+        return 0;
+    }
+
+    // Stay on the current lane until it used its weight or ran empty,
+    // then the next lane that has messages gets a fresh quota
+    if (bb->laneCredits > 0 && laneHasMessages(bb, bb->currentLane)) {
+        bb->laneCredits--;
+        return bb->currentLane;
+    }
+    for (int i = 1; i <= bb->numOfLanes; i++) {
+        int lane = (bb->currentLane + i) % bb->numOfLanes;
+        if (laneHasMessages(bb, lane)) {
+            bb->currentLane = lane;
+            bb->laneCredits = bb->laneWeights[lane] - 1;
+            return lane;
+        }
+    }
+    return bb->currentLane;
+}
+
+/**
+ * Waits for a semaphore
+ * @param sem the semaphore
+ * @param timeoutUsec how long to wait, 0 to not wait at all, negative to wait forever
+ * @return 0 once the semaphore was taken, -1 on timeout
+*/
+int waitSemaphore(sem_t *sem, long long timeoutUsec) {
+    if (timeoutUsec == 0) return sem_trywait(sem) == 0 ? 0 : -1;
+
+    if (timeoutUsec < 0) {
+        while (sem_wait(sem) != 0) {
+            if (errno != EINTR) return -1;
+        }
+        return 0;
+    }
+
+    // sem_timedwait takes an absolute deadline on the realtime clock
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutUsec / 1000000;
+    deadline.tv_nsec += (timeoutUsec % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(sem, &deadline) != 0) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns the current time on the monotonic clock
+*/
+static long long monotonicNs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+ * Returns how long a wait may still sleep
+ * @param timeoutUsec the timeout of the whole operation
+ * @param deadlineNs when it ends, for a positive timeout
+ * @return microseconds left, 0 if the wait is over, negative to wait forever
+*/
+static long long timeLeftUsec(long long timeoutUsec, long long deadlineNs) {
+    if (timeoutUsec <= 0) return timeoutUsec;
+    long long leftNs = deadlineNs - monotonicNs();
+    return leftNs <= 0 ? 0 : (leftNs + 999) / 1000;
+}
+
+/**
+ * Returns whether there is room for one more message, looking at the
+ * consumer side only when the cached count says the buffer is full.
+ * Called with the producer lock held.
+*/
+static int hasRoom(BoundedBuffer *bb, long long inserted) {
+    if (inserted - bb->cachedRemoveCount < bb->size) return 1;
+    // Acquire, the consumer that freed the slot is done reading it
+    bb->cachedRemoveCount = atomic_load_explicit(&bb->removeCount, memory_order_acquire);
+    return inserted - bb->cachedRemoveCount < bb->size;
+}
+
+/**
+ * Returns whether there is a message to remove, looking at the producer
+ * side only when the cached count says the buffer is empty.
+ * Called with the consumer lock held.
+*/
+static int hasMessage(BoundedBuffer *bb, long long removed) {
+    if (removed < bb->cachedInsertCount) return 1;
+    // Acquire, so the slot and lane counts of what we see are there too
+    bb->cachedInsertCount = atomic_load_explicit(&bb->insertCount, memory_order_acquire);
+    return removed < bb->cachedInsertCount;
+}
+
+/**
+ * Wakes a sleeper of the other side, if there is one, after this side
+ * published what it waits for. The waker takes the sleeper's registration,
+ * so every sleep gets a single post, not one for every message meanwhile.
+*/
+static void wakeSleeper(sem_t *sem, atomic_int *sleepers) {
+    // Pairs with the fence of a thread going to sleep: either we see it
+    // here, or it sees what we published when it looks once more
+    atomic_thread_fence(memory_order_seq_cst);
+    int n = atomic_load_explicit(sleepers, memory_order_relaxed);
+    while (n > 0 && !atomic_compare_exchange_weak(sleepers, &n, n - 1)) { }
+    if (n > 0) sem_post(sem);
+}
+
+/**
+ * Takes back the registration of a sleep that didn't happen or timed out.
+ * If a waker took it already, its post is left over and only makes a later
+ * sleeper look once more.
+*/
+static void cancelSleep(atomic_int *sleepers) {
+    int n = atomic_load(sleepers);
+    while (n > 0 && !atomic_compare_exchange_weak(sleepers, &n, n - 1)) { }
+}
+
+/**
+ * Inserts a new message to the buffer, waiting at most timeoutUsec for room
+ * @param bb pointer to the buffer
+ * @param msg message to insert
+ * @param timeoutUsec how long to wait, 0 to not wait at all, BUFFER_WAIT_FOREVER to block
+ * @return BUFFER_OK on success, BUFFER_TIMEOUT if there was no room in time,
+ *         BUFFER_CLOSED if the buffer is closed. The caller keeps the message on failure
+*/
+int insertToBufferTimed(BoundedBuffer *bb, Message *msg, long long timeoutUsec) {
+    long long deadlineNs = timeoutUsec > 0 ? monotonicNs() + timeoutUsec * 1000 : 0;
+
+    pthread_mutex_lock(&bb->producerLock);
+    long long inserted;
+    while (1) {
+        if (atomic_load_explicit(&bb->isClosed, memory_order_relaxed)) {
+            pthread_mutex_unlock(&bb->producerLock);
+            // Pass the wake up on to the next writer sleeping on the closed buffer
+            sem_post(&bb->writeSemaphore);
+            return BUFFER_CLOSED;
+        }
+        inserted = atomic_load_explicit(&bb->insertCount, memory_order_relaxed);
+        if (hasRoom(bb, inserted)) break;
+
+        long long waitUsec = timeLeftUsec(timeoutUsec, deadlineNs);
+        if (waitUsec == 0) {
+            pthread_mutex_unlock(&bb->producerLock);
+            return BUFFER_TIMEOUT;
+        }
+        // Announce the sleep, then look once more: a slot freed before the
+        // announcement is found now, one freed after it posts the semaphore
+        atomic_fetch_add(&bb->sleepingProducers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (hasRoom(bb, inserted) || atomic_load(&bb->isClosed)) {
+            cancelSleep(&bb->sleepingProducers);
+            continue;
+        }
+        pthread_mutex_unlock(&bb->producerLock);
+        if (waitSemaphore(&bb->writeSemaphore, waitUsec) != 0) cancelSleep(&bb->sleepingProducers);
+        pthread_mutex_lock(&bb->producerLock);
+    }
+
+    // Critical section is inserting the message, the counts
+    // guarantee no consumer is reading this slot
+    int lane = 0;
+    if (bb->numOfLanes > 1)
+        lane = msg->priority < 0 ? 0 : msg->priority >= bb->numOfLanes ? bb->numOfLanes - 1 : msg->priority;
+    bb->lanes[lane][bb->tails[lane]] = msg;
+    bb->tails[lane] = (bb->tails[lane] + 1) % bb->size;
+    if (bb->numOfLanes > 1) {
+        // Release, a consumer that sees the lane count sees the slot
+        long long laneInserted = atomic_load_explicit(&bb->laneInserts[lane], memory_order_relaxed) + 1;
+        atomic_store_explicit(&bb->laneInserts[lane], laneInserted, memory_order_release);
+    }
+    // Release, so a consumer that sees the new total sees the slot and lane count too
+    inserted++;
+    atomic_store_explicit(&bb->insertCount, inserted, memory_order_release);
+
+    // Sample the real occupancy once in a while, for the stats
+    if (inserted % OCCUPANCY_SAMPLE_PERIOD == 0) {
+        bb->cachedRemoveCount = atomic_load_explicit(&bb->removeCount, memory_order_acquire);
+        int occupancy = (int) (inserted - bb->cachedRemoveCount);
+        bb->occupancySum += occupancy;
+        bb->occupancySamples++;
+        if (occupancy > bb->maxOccupancy) bb->maxOccupancy = occupancy;
+    }
+    pthread_mutex_unlock(&bb->producerLock);
+
+    wakeSleeper(&bb->readSemaphore, &bb->sleepingConsumers);
+    if (bb->signalEvents & SIGNAL_ON_INSERT) notifySignal(bb->signal);
+    return BUFFER_OK;
+}
+
 /**
  * Inserts a new message to the buffer
  * @param bb pointer to the buffer
  * @param msg message to insert
- * @return 0 on success
-*/
-int insertToBuffer(BoundedBuffer *bb, char *msg) {
-    // lock the buffer using semaphore and mutex
-    sem_wait(&bb->writeSemaphore);
-    pthread_mutex_lock(&bb->lock);
-    // Critical section is inserting the message
-    bb->buffer[bb->tail] = msg;
-    bb->tail = (bb->tail + 1) % bb->size;
-    // unlock
-    pthread_mutex_unlock(&bb->lock);
-    sem_post(&bb->readSemaphore);
-    return 0;
+ * @return BUFFER_OK on success, BUFFER_CLOSED if the buffer is closed
+*/
+int insertToBuffer(BoundedBuffer *bb, Message *msg) {
+    return insertToBufferTimed(bb, msg, BUFFER_WAIT_FOREVER);
 }
 
 /**
- * Removes a message from the buffer
+ * Tries to insert a new message to the buffer without blocking
+ * @param bb pointer to the buffer
+ * @param msg message to insert
+ * @return BUFFER_OK on success, BUFFER_TIMEOUT if the buffer is full,
+ *         BUFFER_CLOSED if the buffer is closed
+ */
+int tryInsertToBuffer(BoundedBuffer *bb, Message *msg) {
+    return insertToBufferTimed(bb, msg, 0);
+}
+
+/**
+ * Removes a message from the buffer, waiting at most timeoutUsec for one.
+ * Messages inserted before the buffer was closed are still handed out,
+ * only then the readers get BUFFER_CLOSED.
  * @param bb pointer to the buffer
- * @return the removed message
+ * @param timeoutUsec how long to wait, 0 to not wait at all, BUFFER_WAIT_FOREVER to block
+ * @param status set to BUFFER_OK, BUFFER_TIMEOUT or BUFFER_CLOSED, may be NULL
+ * @return the removed message, or NULL if there is none
 */
-char* removeFromBuffer(BoundedBuffer* bb) {
-    // lock the buffer using semaphore and mutex
-    sem_wait(&bb->readSemaphore);
-    pthread_mutex_lock(&bb->lock);
+Message* removeFromBufferTimed(BoundedBuffer* bb, long long timeoutUsec, int *status) {
+    long long deadlineNs = timeoutUsec > 0 ? monotonicNs() + timeoutUsec * 1000 : 0;
+
+    pthread_mutex_lock(&bb->consumerLock);
+    long long removed = atomic_load_explicit(&bb->removeCount, memory_order_relaxed);
+    while (!hasMessage(bb, removed)) {
+        // The buffer is closed after its last insert, so once we see it
+        // closed, one more look at insertCount is final
+        if (atomic_load_explicit(&bb->isClosed, memory_order_acquire)) {
+            if (hasMessage(bb, removed)) break;
+            pthread_mutex_unlock(&bb->consumerLock);
+            // Pass the wake up on to the next reader sleeping on the closed buffer
+            sem_post(&bb->readSemaphore);
+            if (status) *status = BUFFER_CLOSED;
+            return NULL;
+        }
+
+        long long waitUsec = timeLeftUsec(timeoutUsec, deadlineNs);
+        if (waitUsec == 0) {
+            pthread_mutex_unlock(&bb->consumerLock);
+            if (status) *status = BUFFER_TIMEOUT;
+            return NULL;
+        }
+        // Announce the sleep, then look once more: a message inserted before
+        // the announcement is found now, one inserted after it posts the semaphore
+        atomic_fetch_add(&bb->sleepingConsumers, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (hasMessage(bb, removed) || atomic_load(&bb->isClosed)) {
+            cancelSleep(&bb->sleepingConsumers);
+            continue;
+        }
+        pthread_mutex_unlock(&bb->consumerLock);
+        if (waitSemaphore(&bb->readSemaphore, waitUsec) != 0) cancelSleep(&bb->sleepingConsumers);
+        pthread_mutex_lock(&bb->consumerLock);
+        removed = atomic_load_explicit(&bb->removeCount, memory_order_relaxed);
+    }
+
     // Critical section is removing the message
-    char *msgToReturn = bb->buffer[bb->head];
-    bb->head = (bb->head + 1) % bb->size;
-    // unlock
-    pthread_mutex_unlock(&bb->lock);
-    sem_post(&bb->writeSemaphore);
-    // return the message that was removed
+    int lane = 0;
+    if (bb->numOfLanes > 1) {
+        lane = pickLane(bb);
+        bb->laneRemoves[lane]++;
+    }
+    Message *msgToReturn = bb->lanes[lane][bb->heads[lane]];
+    bb->heads[lane] = (bb->heads[lane] + 1) % bb->size;
+    // Release, a producer that sees the new count may reuse the slot
+    atomic_store_explicit(&bb->removeCount, removed + 1, memory_order_release);
+    pthread_mutex_unlock(&bb->consumerLock);
+
+    wakeSleeper(&bb->writeSemaphore, &bb->sleepingProducers);
+    if (bb->signalEvents & SIGNAL_ON_REMOVE) notifySignal(bb->signal);
+    if (status) *status = BUFFER_OK;
     return msgToReturn;
 }
 
+/**
+ * Removes a message from the buffer
+ * @param bb pointer to the buffer
+ * @return the removed message, or NULL once the buffer is closed and empty
+*/
+Message* removeFromBuffer(BoundedBuffer* bb) {
+    return removeFromBufferTimed(bb, BUFFER_WAIT_FOREVER, NULL);
+}
+
 /**
  * Tries to remove a message from the buffer without blocking
  * @param bb pointer to the buffer
  * @return the removed message, or NULL if the buffer is empty
  */
-char* tryRemoveFromBuffer(BoundedBuffer* bb) {
-    // If the semaphore is 0, return NULL immediately (don't block)
-    if (sem_trywait(&bb->readSemaphore) != 0) {
-        return NULL; 
-    }
-    
-    pthread_mutex_lock(&bb->lock);
-    char *msgToReturn = bb->buffer[bb->head];
-    bb->head = (bb->head + 1) % bb->size;
-    pthread_mutex_unlock(&bb->lock);
-    
+Message* tryRemoveFromBuffer(BoundedBuffer* bb) {
+    return removeFromBufferTimed(bb, 0, NULL);
+}
+
+/**
+ * Closes the buffer. Writers fail from now on, readers get what is left
+ * and then fail, and everyone that waits on the buffer wakes up right away.
+ * Every woken thread posts the semaphore again on its way out, so a single
+ * post is enough no matter how many threads wait.
+ * @param bb pointer to the buffer
+*/
+void closeBuffer(BoundedBuffer* bb) {
+    // Under the producer lock, so an insert either finishes before or fails
+    pthread_mutex_lock(&bb->producerLock);
+    if (atomic_load_explicit(&bb->isClosed, memory_order_relaxed)) {
+        pthread_mutex_unlock(&bb->producerLock);
+        return;
+    }
+    // Release, a reader that sees it closed sees every insert before it
+    atomic_store_explicit(&bb->isClosed, 1, memory_order_release);
+    pthread_mutex_unlock(&bb->producerLock);
+
+    sem_post(&bb->readSemaphore);
     sem_post(&bb->writeSemaphore);
-    return msgToReturn;
+    if (bb->signalEvents & SIGNAL_ON_INSERT) notifySignal(bb->signal);
 }
 
 /**
@@ -89,10 +487,7 @@ char* tryRemoveFromBuffer(BoundedBuffer* bb) {
  * @return 1 if the buffer is empty, 0 otherwise
 */
 int isBufferEmpty(BoundedBuffer* bb) {
-    pthread_mutex_lock(&bb->lock);
-    int empty = (bb->head == bb->tail);
-    pthread_mutex_unlock(&bb->lock);
-    return empty;
+    return atomic_load(&bb->removeCount) == atomic_load(&bb->insertCount);
 }
 
 /**
@@ -101,10 +496,124 @@ int isBufferEmpty(BoundedBuffer* bb) {
  */
 void destroyBuffer(BoundedBuffer* bb) {
     if (bb) {
-        pthread_mutex_destroy(&bb->lock);
+        pthread_mutex_destroy(&bb->producerLock);
+        pthread_mutex_destroy(&bb->consumerLock);
         sem_destroy(&bb->readSemaphore);
         sem_destroy(&bb->writeSemaphore);
-        free(bb->buffer);
+        if (bb->nodeMask != 0) {
+            size_t laneBytes = sizeof(Message*) * bb->size;
+            for (int lane = 1; lane < MAX_PRIORITY_LANES; lane++)
+                freeOnNodes(bb->lanes[lane], laneBytes);
+            // Lane 0 goes with the struct
+            freeOnNodes(bb, sizeof(BoundedBuffer) + laneBytes);
+            return;
+        }
+        for (int lane = 0; lane < MAX_PRIORITY_LANES; lane++)
+            free(bb->lanes[lane]);
         free(bb);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Creates a signal. It is mapped shared, so processes forked afterwards
+ * signal the same one.
+ * @return pointer to the signal, or NULL on failure
+*/
+BufferSignal* initBufferSignal(void) {
+    BufferSignal *signal = (BufferSignal*) mmap(NULL, sizeof(BufferSignal), PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (signal == MAP_FAILED) return NULL;
+
+    // A producer process that dies holding the lock must not hang the others
+    pthread_mutexattr_t mutexAttr;
+    pthread_mutexattr_init(&mutexAttr);
+    pthread_mutexattr_setpshared(&mutexAttr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutexAttr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&signal->lock, &mutexAttr);
+    pthread_mutexattr_destroy(&mutexAttr);
+
+    pthread_condattr_t condAttr;
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setpshared(&condAttr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&signal->cond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+
+    atomic_init(&signal->events, 0);
+    atomic_init(&signal->sleepers, 0);
+    return signal;
+}
+
+/**
+ * Locks the signal, recovering the lock if its holder died. Nothing it
+ * guards can be left half updated, so taking it over is enough.
+*/
+static void lockSignal(BufferSignal *signal) {
+    if (pthread_mutex_lock(&signal->lock) == EOWNERDEAD) pthread_mutex_consistent(&signal->lock);
+}
+
+/**
+ * Wakes everyone sleeping on the signal. The caller must have published
+ * what the sleepers wait for (the message, the closed flag, the free slot)
+ * before calling it.
+ * @param signal the signal
+*/
+void notifySignal(BufferSignal *signal) {
+    // Pairs with the increment in prepareSignalWait: either we see the
+    // sleeper here, or it sees what we published when it looks once more
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&signal->sleepers, memory_order_relaxed) == 0) return;
+
+    lockSignal(signal);
+    atomic_fetch_add(&signal->events, 1);
+    pthread_cond_broadcast(&signal->cond);
+    pthread_mutex_unlock(&signal->lock);
+}
+
+/**
+ * Announces a sleep on the signal. After it, the caller has to look for
+ * work once more, and then either waitForSignal or cancelSignalWait.
+ * @param signal the signal
+ * @return the events seen so far, for waitForSignal
+*/
+long long prepareSignalWait(BufferSignal *signal) {
+    atomic_fetch_add(&signal->sleepers, 1);
+    // Pairs with the fence in notifySignal
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load(&signal->events);
+}
+
+/**
+ * Sleeps until the signal is notified, unless it already was since
+ * prepareSignalWait, and ends the announced sleep
+ * @param signal the signal
+ * @param seen what prepareSignalWait returned
+*/
+void waitForSignal(BufferSignal *signal, long long seen) {
+    lockSignal(signal);
+    while (atomic_load(&signal->events) == seen) {
+        if (pthread_cond_wait(&signal->cond, &signal->lock) == EOWNERDEAD)
+            pthread_mutex_consistent(&signal->lock);
+    }
+    pthread_mutex_unlock(&signal->lock);
+    atomic_fetch_sub(&signal->sleepers, 1);
+}
+
+/**
+ * Ends a sleep announced by prepareSignalWait without sleeping
+ * @param signal the signal
+*/
+void cancelSignalWait(BufferSignal *signal) {
+    atomic_fetch_sub(&signal->sleepers, 1);
+}
+
+/**
+ * Destroys the signal, nobody may use it anymore
+ * @param signal pointer to the signal
+*/
+void destroyBufferSignal(BufferSignal *signal) {
+    if (signal) {
+        pthread_mutex_destroy(&signal->lock);
+        pthread_cond_destroy(&signal->cond);
+        munmap(signal, sizeof(BufferSignal));
+    }
+}
@@ -7,34 +7,153 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <stdatomic.h>
+#include "Message.h"
 
 #define FINISH_MSG "DONE"
 
+// Status of the buffer operations
+#define BUFFER_OK 0
+#define BUFFER_TIMEOUT -1   // Timed out, or the buffer was full / empty for the try operations
+#define BUFFER_CLOSED -2    // The buffer was closed (and, for removing, nothing is left in it)
+
+// Timeout that waits forever
+#define BUFFER_WAIT_FOREVER -1
+
+// Size of a cache line, fields written by different threads are kept this far apart
+#define CACHE_LINE_SIZE 64
+
+// The producer side samples the occupancy once every that many inserts
+#define OCCUPANCY_SAMPLE_PERIOD 16
+
+// Most priority lanes a buffer can have, a message goes to the lane of its priority
+#define MAX_PRIORITY_LANES 4
+
+/**
+ * How consumers choose the lane to take the next message from
+*/
+typedef enum LaneSchedule {
+    LANES_STRICT = 0,           // Always the highest lane that has a message
+    LANES_WEIGHTED              // Round robin, up to laneWeights[lane] messages in a row
+} LaneSchedule;
+
+// What a buffer tells its signal about, see setBufferSignal
+#define SIGNAL_ON_INSERT 1          // Inserts and closing, there is something to take
+#define SIGNAL_ON_REMOVE 2          // Removes, there is room again
+
 /**
- * Struct for a bounded buffer of the  producer consumer
+ * Wakes whoever sleeps until something happens in any of a group of buffers,
+ * like a dispatcher that serves many producers. It lives in a shared mapping,
+ * so producer processes forked after it was created can signal it as well.
+ * While nobody sleeps on it, signalling costs a fence and a load.
+*/
+typedef struct BufferSignal {
+    pthread_mutex_t lock;           // Process shared and robust
+    pthread_cond_t cond;            // Process shared
+    atomic_llong events;            // Advanced under the lock by every wake up
+    atomic_int sleepers;            // Between prepareSignalWait and the end of their wait
+} BufferSignal;
+
+// Each side of a buffer starts a cache line of its own. Building with
+// BUFFER_PACKED_LAYOUT packs them together instead, as a baseline for the
+// benchmark (make buffer_bench_packed.out)
+#ifdef BUFFER_PACKED_LAYOUT
+#define CACHE_ALIGNED
+#else
+#define CACHE_ALIGNED _Alignas(CACHE_LINE_SIZE)
+#endif
+
+/**
+ * Struct for a bounded buffer of the  producer consumer.
+ * Producers and consumers each have their own lock, index and counter, on
+ * cache lines of their own, so the two sides don't invalidate each other's
+ * lines on every message. Each side keeps a cached copy of the other side's
+ * counter, and only reads the real one when the copy says the buffer is full
+ * (or empty). The semaphores are only for sleeping: a side posts the other
+ * side's semaphore only while someone sleeps on it, so neither a semaphore
+ * nor the other side's counter is touched while the buffer is neither full
+ * nor empty. Every semaphore has a line of its own, next to its sleeper count.
 */
 typedef struct BoundedBuffer {
-    char **buffer;
+    // Set once, read by everyone
+    Message **lanes[MAX_PRIORITY_LANES];// Every lane is a ring of size slots
     int size;
-    int head;
-    int tail;
     int id;
-    int isDone;
-    pthread_mutex_t lock;
-    sem_t writeSemaphore;
-    sem_t readSemaphore;
+    int numOfLanes;                     // 1 unless setBufferLanes was called
+    int laneSchedule;
+    int laneWeights[MAX_PRIORITY_LANES];
+    unsigned long nodeMask;             // NUMA nodes the memory is bound to, 0 if it came from malloc
+    atomic_int isClosed;                // Set by closeBuffer under the producer lock
+    BufferSignal *signal;               // NULL unless setBufferSignal was called
+    int signalEvents;                   // SIGNAL_ON_* flags
+
+    // Producer side
+    CACHE_ALIGNED pthread_mutex_t producerLock;
+    int tails[MAX_PRIORITY_LANES];
+    atomic_llong insertCount;           // Messages ever inserted, read by consumers
+    atomic_llong laneInserts[MAX_PRIORITY_LANES]; // Only counted with more than one lane
+    long long cachedRemoveCount;        // Last removeCount the producers saw
+    long long occupancySum;             // Occupancy stats for the benchmark,
+    long long occupancySamples;         // sampled every OCCUPANCY_SAMPLE_PERIOD inserts
+    int maxOccupancy;
+
+    // Consumer side
+    CACHE_ALIGNED pthread_mutex_t consumerLock;
+    int heads[MAX_PRIORITY_LANES];
+    atomic_llong removeCount;           // Messages ever removed, read by producers
+    long long cachedInsertCount;        // Last insertCount the consumers saw
+    long long laneRemoves[MAX_PRIORITY_LANES];
+    long long cachedLaneInserts[MAX_PRIORITY_LANES];
+    int currentLane;                    // Lane being served by the weighted schedule
+    int laneCredits;                    // Messages it may still take from it in a row
+
+    // Producers sleep here while the buffer is full, consumers post it
+    CACHE_ALIGNED sem_t writeSemaphore;
+    atomic_int sleepingProducers;
+
+    // Consumers sleep here while the buffer is empty, producers post it
+    CACHE_ALIGNED sem_t readSemaphore;
+    atomic_int sleepingConsumers;
 } BoundedBuffer;
 
+// Waits for a semaphore, 0 to not wait at all, negative to wait forever
+int waitSemaphore(sem_t *sem, long long timeoutUsec);
+
 // Initializes the buffer
 BoundedBuffer* initBuffer(int bufferSize, int id);
 
+// Initializes a buffer with its memory bound to NUMA nodes
+BoundedBuffer* initBufferOnNodes(int bufferSize, int id, unsigned long nodeMask);
+
+// Splits the buffer into priority lanes, before any thread uses it
+int setBufferLanes(BoundedBuffer *bb, int numOfLanes, int schedule, const int *weights);
+
+// Makes the buffer wake the sleepers of a signal, before any thread uses it
+void setBufferSignal(BoundedBuffer *bb, BufferSignal *signal, int events);
+
+// Parses "strict" or "weighted <w0> <w1> ..." into a schedule and lane weights
+int parseLaneSchedule(const char *text, int *schedule, int *weights);
+
 // Inserts a new message to the buffer
-int insertToBuffer(BoundedBuffer *bb, char *msg);
+int insertToBuffer(BoundedBuffer *bb, Message *msg);
+
+// Inserts a new message to the buffer without blocking
+int tryInsertToBuffer(BoundedBuffer *bb, Message *msg);
+
+// Inserts a new message to the buffer, waiting at most timeoutUsec for room
+int insertToBufferTimed(BoundedBuffer *bb, Message *msg, long long timeoutUsec);
 
 // Removes a message from the buffer
-char* removeFromBuffer(BoundedBuffer* bb);
+Message* removeFromBuffer(BoundedBuffer* bb);
 
-char* tryRemoveFromBuffer(BoundedBuffer* bb);
+// Removes a message from the buffer without blocking
+Message* tryRemoveFromBuffer(BoundedBuffer* bb);
+
+// Removes a message from the buffer, waiting at most timeoutUsec for one
+Message* removeFromBufferTimed(BoundedBuffer* bb, long long timeoutUsec, int *status);
+
+// Closes the buffer and wakes everyone waiting on it
+void closeBuffer(BoundedBuffer* bb);
 
 // Checks if the buffer is empty
 int isBufferEmpty(BoundedBuffer* bb);
@@ -42,4 +161,22 @@ int isBufferEmpty(BoundedBuffer* bb);
 // Destroys the buffer and frees memory
 void destroyBuffer(BoundedBuffer* bb);
 
+// Creates a signal in a shared mapping, before forking the processes that use it
+BufferSignal* initBufferSignal(void);
+
+// Wakes everyone sleeping on the signal, after publishing what they wait for
+void notifySignal(BufferSignal *signal);
+
+// Announces a sleep on the signal, returns what to pass to waitForSignal
+long long prepareSignalWait(BufferSignal *signal);
+
+// Sleeps until the signal was notified after prepareSignalWait returned seen
+void waitForSignal(BufferSignal *signal, long long seen);
+
+// Gives up a sleep announced by prepareSignalWait
+void cancelSignalWait(BufferSignal *signal);
+
+// Destroys the signal and unmaps it
+void destroyBufferSignal(BufferSignal *signal);
+
 #endif
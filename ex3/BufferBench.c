@@ -0,0 +1,84 @@
+// Yuval Anteby 212152896
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "BoundedBuffer.h"
+#include "Bench.h"
+
+// Microbenchmark of a single BoundedBuffer, nothing but inserts and removes.
+// Usage: ./buffer_bench.out [messages] [buffer size] [producers] [consumers]
+
+typedef struct ForBenchThread {
+    BoundedBuffer *bb;
+    Message *msg;
+    long long messages;
+} ForBenchThread;
+
+/**
+ * Inserts the same message over and over, the payload isn't what we measure
+*/
+void* benchProducer(void *arg) {
+    ForBenchThread *forThread = (ForBenchThread*)arg;
+    for (long long i = 0; i < forThread->messages; i++)
+        insertToBuffer(forThread->bb, forThread->msg);
+    return NULL;
+}
+
+/**
+ * Removes messages until the buffer is closed and empty
+*/
+void* benchConsumer(void *arg) {
+    ForBenchThread *forThread = (ForBenchThread*)arg;
+    while (removeFromBuffer(forThread->bb) != NULL) { }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    long long messages = argc > 1 ? atoll(argv[1]) : 10000000;
+    int bufferSize = argc > 2 ? atoi(argv[2]) : 1024;
+    int producersCount = argc > 3 ? atoi(argv[3]) : 1;
+    int consumersCount = argc > 4 ? atoi(argv[4]) : 1;
+    if (messages < 1 || bufferSize < 1 || producersCount < 1 || consumersCount < 1) {
+        printf("Usage: %s [messages] [buffer size] [producers] [consumers]\n", argv[0]);
+        return 1;
+    }
+
+    BoundedBuffer *bb = initBuffer(bufferSize, 0);
+    Message *msg = createMessage(0, 0, 0);
+    if (bb == NULL || msg == NULL) {
+        printf("Failed to allocate memory\n");
+        return 1;
+    }
+
+    pthread_t producers[producersCount];
+    pthread_t consumers[consumersCount];
+    ForBenchThread forProducers[producersCount];
+    ForBenchThread forConsumer = { bb, NULL, 0 };
+
+    long long startNs = nowNs();
+    for (int i = 0; i < consumersCount; i++)
+        pthread_create(&consumers[i], NULL, benchConsumer, &forConsumer);
+    for (int i = 0; i < producersCount; i++) {
+        forProducers[i].bb = bb;
+        forProducers[i].msg = msg;
+        // Split the messages as evenly as possible
+        forProducers[i].messages = messages / producersCount + (i < messages % producersCount);
+        pthread_create(&producers[i], NULL, benchProducer, &forProducers[i]);
+    }
+    for (int i = 0; i < producersCount; i++)
+        pthread_join(producers[i], NULL);
+    closeBuffer(bb);
+    for (int i = 0; i < consumersCount; i++)
+        pthread_join(consumers[i], NULL);
+    long long elapsedNs = nowNs() - startNs;
+
+    printf("{\"impl\":\"%s\",\"bench\":\"buffer\",\"messages\":%lld,\"buffer_size\":%d,"
+           "\"producers\":%d,\"consumers\":%d,\"seconds\":%.6f,\"ns_per_msg\":%.1f,\"msgs_per_sec\":%.1f}\n",
+           BUFFER_IMPL, messages, bufferSize, producersCount, consumersCount, elapsedNs / 1e9,
+           (double) elapsedNs / messages, messages / (elapsedNs / 1e9));
+
+    free(msg);
+    destroyBuffer(bb);
+    return 0;
+}
@@ -0,0 +1,674 @@
+// Yuval Anteby 212152896
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Config.h"
+#include "BoundedBuffer.h"
+#include "Message.h"
+#include "Overflow.h"
+#include "OutputStage.h"
+
+/**
+ * Where the parser is in the config file, for error messages
+*/
+typedef struct ConfigParser {
+    const char *path;
+    int line;                   // Current line, 0 once the whole file was read
+    ConfigData *data;
+    int producersCapacity;      // Allocated entries of producersInfo
+    int categoriesCapacity;     // Allocated entries of categoriesInfo
+} ConfigParser;
+
+/**
+ * Prints where and why the config is invalid, then exits
+*/
+static void configError(const ConfigParser *p, const char *format, ...) {
+    va_list args;
+    if (p->line > 0) printf("%s:%d: ", p->path, p->line);
+    else printf("%s: ", p->path);
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Parses a whole integer value, nothing but spaces may follow it
+ * @param p the parser, for errors
+ * @param key name of the setting, for errors
+ * @param value text of the value
+ * @param min smallest valid value
+ * @param max largest valid value
+ * @return the value
+*/
+static long long parseInteger(const ConfigParser *p, const char *key, const char *value,
+                              long long min, long long max) {
+    char *end;
+    errno = 0;
+    long long n = strtoll(value, &end, 10);
+    while (isspace((unsigned char) *end)) end++;
+    if (end == value || *end != '\0' || errno != 0 || n < min || n > max)
+        configError(p, "%s must be an integer between %lld and %lld, got '%s'", key, min, max, value);
+    return n;
+}
+
+/**
+ * Parses yes / no (or true / false)
+*/
+static int parseBool(const ConfigParser *p, const char *key, const char *value) {
+    if (strcmp(value, "yes") == 0 || strcmp(value, "true") == 0) return 1;
+    if (strcmp(value, "no") == 0 || strcmp(value, "false") == 0) return 0;
+    configError(p, "%s must be yes or no, got '%s'", key, value);
+    return 0;
+}
+
+static void setCoEditorQueueSize(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->coEditorQueueSize = (int) parseInteger(p, key, value, 1, INT_MAX);
+}
+
+static void setScreenOutput(ConfigParser *p, const char *key, const char *value, int arg) {
+    if (*value == '\0') configError(p, "%s must not be empty", key);
+    free(p->data->outputTarget);
+    p->data->outputTarget = strdup(value);
+}
+
+static void setScreenBufferSize(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->outputBufferSize = (int) parseInteger(p, key, value, OUTPUT_CHUNKS, INT_MAX);
+}
+
+static void setScreenLatency(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->outputLatencyUsec = parseInteger(p, key, value, 0, LLONG_MAX / 1000);
+}
+
+static void setDispatchers(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->numOfDispatchers = (int) parseInteger(p, key, value, 1, 1024);
+}
+
+static void setProducerProcesses(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->producerProcesses = parseBool(p, key, value);
+}
+
+static void setOverflowPolicy(ConfigParser *p, const char *key, const char *value, int arg) {
+    if ((p->data->overflowPolicy = parseOverflowPolicy(value)) < 0)
+        configError(p, "%s must be block, drop-oldest or spill, got '%s'", key, value);
+}
+
+static void setOverflowSize(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->overflowSize = (int) parseInteger(p, key, value, 1, INT_MAX);
+}
+
+static void setPriorityLanes(ConfigParser *p, const char *key, const char *value, int arg) {
+    p->data->numOfLanes = (int) parseInteger(p, key, value, 1, MAX_PRIORITY_LANES);
+}
+
+static void setLaneSchedule(ConfigParser *p, const char *key, const char *value, int arg) {
+    if (parseLaneSchedule(value, &p->data->laneSchedule, p->data->laneWeights) != 0)
+        configError(p, "%s must be strict or weighted followed by positive lane weights, got '%s'",
+                    key, value);
+}
+
+static void setEditCost(ConfigParser *p, const char *key, const char *value, int arg) {
+    if (parseEditCost(value, &p->data->editCost) != 0)
+        configError(p, "%s must be none, fixed <usec>, uniform <usec> or exponential <usec>, got '%s'",
+                    key, value);
+}
+
+static void setRoleCpus(ConfigParser *p, const char *key, const char *value, int role) {
+    if (parseCpuList(value, &p->data->affinity.cpus[role]) != 0)
+        configError(p, "%s must be a CPU list like 0-3,8, got '%s'", key, value);
+    p->data->affinity.isPinned[role] = 1;
+    p->data->affinity.nodeMask[role] = cpuNodeMask(&p->data->affinity.cpus[role]);
+}
+
+/**
+ * A top level setting, with its name in the text and in the JSON form
+*/
+typedef struct ConfigSetting {
+    const char *textKey;
+    const char *jsonKey;
+    void (*apply)(ConfigParser *p, const char *key, const char *value, int arg);
+    int arg;
+} ConfigSetting;
+
+static const ConfigSetting settings[] = {
+    { "Co-Editor queue size", "co_editor_queue_size", setCoEditorQueueSize, 0 },
+    { "Screen output", "screen_output", setScreenOutput, 0 },
+    { "Screen buffer size", "screen_buffer_size", setScreenBufferSize, 0 },
+    { "Screen latency", "screen_latency", setScreenLatency, 0 },
+    { "Dispatchers", "dispatchers", setDispatchers, 0 },
+    { "Producer processes", "producer_processes", setProducerProcesses, 0 },
+    { "Overflow policy", "overflow_policy", setOverflowPolicy, 0 },
+    { "Overflow size", "overflow_size", setOverflowSize, 0 },
+    { "Edit cost", "edit_cost", setEditCost, 0 },
+    { "Priority lanes", "priority_lanes", setPriorityLanes, 0 },
+    { "Lane schedule", "lane_schedule", setLaneSchedule, 0 },
+    { "Producer CPUs", "producer_cpus", setRoleCpus, ROLE_PRODUCER },
+    { "Dispatcher CPUs", "dispatcher_cpus", setRoleCpus, ROLE_DISPATCHER },
+    { "Co-Editor CPUs", "co_editor_cpus", setRoleCpus, ROLE_CO_EDITOR },
+    { "Screen CPUs", "screen_cpus", setRoleCpus, ROLE_SCREEN },
+};
+#define NUM_SETTINGS ((int) (sizeof(settings) / sizeof(settings[0])))
+
+static void setCoEditors(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    info->numOfCoEditors = (int) parseInteger(p, key, value, 1, 4096);
+}
+
+static void setWorkers(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    info->numOfWorkers = (int) parseInteger(p, key, value, 1, 4096);
+}
+
+static void setCategoryQueueSize(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    info->queueSize = (int) parseInteger(p, key, value, 1, INT_MAX);
+}
+
+static void setCategoryEditCost(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    if (parseEditCost(value, &info->editCost) != 0)
+        configError(p, "%s of %s must be none, fixed <usec>, uniform <usec> or exponential <usec>, got '%s'",
+                    key, info->name, value);
+}
+
+static void setCategoryOverflowPolicy(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    if ((info->overflowPolicy = parseOverflowPolicy(value)) < 0)
+        configError(p, "%s of %s must be block, drop-oldest or spill, got '%s'", key, info->name, value);
+}
+
+static void setCategoryOverflowSize(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    info->overflowSize = (int) parseInteger(p, key, value, 1, INT_MAX);
+}
+
+static void setCategoryPriority(ConfigParser *p, CategoryInfo *info, const char *key, const char *value) {
+    info->priority = (int) parseInteger(p, key, value, 0, MAX_PRIORITY_LANES - 1);
+}
+
+/**
+ * A setting inside a category block
+*/
+typedef struct CategorySetting {
+    const char *textKey;
+    const char *jsonKey;
+    void (*apply)(ConfigParser *p, CategoryInfo *info, const char *key, const char *value);
+} CategorySetting;
+
+static const CategorySetting categorySettings[] = {
+    { "co-editors", "co_editors", setCoEditors },
+    { "workers", "workers", setWorkers },
+    { "queue size", "queue_size", setCategoryQueueSize },
+    { "edit cost", "edit_cost", setCategoryEditCost },
+    { "overflow policy", "overflow_policy", setCategoryOverflowPolicy },
+    { "overflow size", "overflow_size", setCategoryOverflowSize },
+    { "priority", "priority", setCategoryPriority },
+};
+#define NUM_CATEGORY_SETTINGS ((int) (sizeof(categorySettings) / sizeof(categorySettings[0])))
+
+/**
+ * Finds a top level setting by its text or JSON name
+ * @return the setting, or NULL if there is none by that name
+*/
+static const ConfigSetting* findSetting(const char *key, int isJson) {
+    for (int i = 0; i < NUM_SETTINGS; i++) {
+        if (strcmp(key, isJson ? settings[i].jsonKey : settings[i].textKey) == 0) return &settings[i];
+    }
+    return NULL;
+}
+
+/**
+ * Finds a category setting by its text or JSON name
+ * @return the setting, or NULL if there is none by that name
+*/
+static const CategorySetting* findCategorySetting(const char *key, int isJson) {
+    for (int i = 0; i < NUM_CATEGORY_SETTINGS; i++) {
+        const char *name = isJson ? categorySettings[i].jsonKey : categorySettings[i].textKey;
+        if (strcmp(key, name) == 0) return &categorySettings[i];
+    }
+    return NULL;
+}
+
+/**
+ * Appends a producer, growing the array as needed
+*/
+static SizeAndMessages* addProducer(ConfigParser *p, int id) {
+    ConfigData *data = p->data;
+    if (data->numOfProducers == p->producersCapacity) {
+        p->producersCapacity = p->producersCapacity ? p->producersCapacity * 2 : 64;
+        SizeAndMessages *grown = (SizeAndMessages*) realloc(data->producersInfo,
+                                    sizeof(SizeAndMessages) * p->producersCapacity);
+        if (grown == NULL) configError(p, "Failed to allocate memory for producers info");
+        data->producersInfo = grown;
+    }
+    SizeAndMessages *producer = &data->producersInfo[data->numOfProducers++];
+    producer->producerId = id;
+    producer->numOfMessages = -1;
+    producer->queueSize = -1;
+    return producer;
+}
+
+/**
+ * Appends a category with every setting unset, growing the array as needed
+*/
+static CategoryInfo* addCategory(ConfigParser *p, const char *name) {
+    ConfigData *data = p->data;
+    if (*name == '\0') configError(p, "A category must have a name");
+    for (int i = 0; i < data->numOfCategories; i++) {
+        if (strcmp(data->categoriesInfo[i].name, name) == 0)
+            configError(p, "Category %s is declared twice", name);
+    }
+    if (data->numOfCategories == p->categoriesCapacity) {
+        p->categoriesCapacity = p->categoriesCapacity ? p->categoriesCapacity * 2 : 8;
+        CategoryInfo *grown = (CategoryInfo*) realloc(data->categoriesInfo,
+                                 sizeof(CategoryInfo) * p->categoriesCapacity);
+        if (grown == NULL) configError(p, "Failed to allocate memory for categories info");
+        data->categoriesInfo = grown;
+    }
+    CategoryInfo *info = &data->categoriesInfo[data->numOfCategories++];
+    info->name = strdup(name);
+    info->numOfCoEditors = 1;
+    info->numOfWorkers = 1;
+    info->queueSize = 0;
+    info->editCost.mode = -1;
+    info->overflowPolicy = -1;
+    info->overflowSize = 0;
+    info->priority = 0;
+    return info;
+}
+
+/**
+ * Removes the spaces around a string, in place
+*/
+static char* trim(char *text) {
+    while (isspace((unsigned char) *text)) text++;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char) end[-1])) end--;
+    *end = '\0';
+    return text;
+}
+
+/**
+ * Splits "key = value" in place
+ * @return the trimmed value, or NULL if the line has no '='
+*/
+static char* splitSetting(char *line, char **key) {
+    char *equals = strchr(line, '=');
+    if (equals == NULL) return NULL;
+    *equals = '\0';
+    *key = trim(line);
+    return trim(equals + 1);
+}
+
+/**
+ * Parses the plain text form in a single pass:
+ * PRODUCER blocks (id, number of messages, queue size), CATEGORY blocks
+ * of "key = value" lines that end with a blank line, and top level settings
+*/
+static void parseText(ConfigParser *p, FILE *file) {
+    enum { TOP, PRODUCER_MESSAGES, PRODUCER_QUEUE, CATEGORY } state = TOP;
+    SizeAndMessages *producer = NULL;
+    CategoryInfo *category = NULL;
+    char *line = NULL;
+    size_t length = 0;
+
+    while (getline(&line, &length, file) != -1) {
+        p->line++;
+        char *text = trim(line);
+        char *key;
+        char *value;
+
+        if (*text == '\0') {
+            // A blank line ends a category block, a producer block must go on
+            if (state == CATEGORY) state = TOP;
+            continue;
+        }
+
+        if (state == PRODUCER_MESSAGES) {
+            producer->numOfMessages = (int) parseInteger(p, "Number of messages", text, 0, INT_MAX);
+            state = PRODUCER_QUEUE;
+            continue;
+        }
+        if (state == PRODUCER_QUEUE) {
+            value = splitSetting(text, &key);
+            if (value == NULL || strcmp(key, "queue size") != 0)
+                configError(p, "PRODUCER %d: expected 'queue size = <n>', got '%s'", producer->producerId, text);
+            producer->queueSize = (int) parseInteger(p, "queue size", value, 1, INT_MAX);
+            state = TOP;
+            continue;
+        }
+
+        if (strncmp(text, "PRODUCER", 8) == 0 && (text[8] == '\0' || isspace((unsigned char) text[8]))) {
+            producer = addProducer(p, (int) parseInteger(p, "Producer id", text + 8, 0, INT_MAX));
+            state = PRODUCER_MESSAGES;
+            continue;
+        }
+        if (strncmp(text, "CATEGORY", 8) == 0 && (text[8] == '\0' || isspace((unsigned char) text[8]))) {
+            category = addCategory(p, trim(text + 8));
+            state = CATEGORY;
+            continue;
+        }
+
+        value = splitSetting(text, &key);
+        if (value == NULL) configError(p, "Expected 'key = value', got '%s'", text);
+        if (state == CATEGORY) {
+            const CategorySetting *setting = findCategorySetting(key, 0);
+            if (setting != NULL) {
+                setting->apply(p, category, key, value);
+                continue;
+            }
+            // Not a category setting, the block ended without a blank line
+            state = TOP;
+        }
+        const ConfigSetting *setting = findSetting(key, 0);
+        if (setting == NULL) configError(p, "Unknown setting '%s'", key);
+        setting->apply(p, key, value, setting->arg);
+    }
+    free(line);
+
+    if (state == PRODUCER_MESSAGES || state == PRODUCER_QUEUE)
+        configError(p, "PRODUCER %d is missing its %s", producer->producerId,
+                    state == PRODUCER_MESSAGES ? "number of messages" : "'queue size = <n>' line");
+}
+
+/**
+ * Reads the JSON form, the whole file is parsed in place
+*/
+typedef struct JsonReader {
+    ConfigParser *p;
+    char *pos;
+    char *counted;              // p->line counts the lines up to here
+} JsonReader;
+
+/**
+ * Brings the parser line up to the current position, for error messages.
+ * Only the text since the last call is scanned, so the whole file is scanned once.
+*/
+static void markLine(JsonReader *r) {
+    for (; r->counted < r->pos; r->counted++) {
+        if (*r->counted == '\n') r->p->line++;
+    }
+}
+
+/**
+ * Prints where the JSON is invalid, then exits
+*/
+static void jsonError(JsonReader *r, const char *what) {
+    markLine(r);
+    configError(r->p, "%s", what);
+}
+
+static void skipSpace(JsonReader *r) {
+    while (isspace((unsigned char) *r->pos)) r->pos++;
+}
+
+static void expectChar(JsonReader *r, char c) {
+    skipSpace(r);
+    if (*r->pos != c) {
+        char what[32];
+        snprintf(what, sizeof(what), "Expected '%c'", c);
+        jsonError(r, what);
+    }
+    r->pos++;
+}
+
+/**
+ * Moves to the next member of an object or array
+ * @param close '}' or ']'
+ * @param count members read so far, updated
+ * @return 1 if there is another member, 0 at the end of the object or array
+*/
+static int nextMember(JsonReader *r, char close, int *count) {
+    skipSpace(r);
+    if (*r->pos == close) {
+        r->pos++;
+        return 0;
+    }
+    if ((*count)++ > 0) expectChar(r, ',');
+    skipSpace(r);
+    return 1;
+}
+
+/**
+ * Reads a string, unescaping it in place
+ * @return the string, it lives in the file buffer
+*/
+static char* readString(JsonReader *r) {
+    expectChar(r, '"');
+    char *out = r->pos;
+    char *result = out;
+    while (*r->pos != '"') {
+        if (*r->pos == '\0') jsonError(r, "Unterminated string");
+        if (*r->pos == '\\') {
+            r->pos++;
+            switch (*r->pos) {
+                case 'n': *out++ = '\n'; break;
+                case 't': *out++ = '\t'; break;
+                case '"': case '\\': case '/': *out++ = *r->pos; break;
+                default: jsonError(r, "Unsupported escape in string");
+            }
+            r->pos++;
+            continue;
+        }
+        *out++ = *r->pos++;
+    }
+    r->pos++;
+    *out = '\0';
+    return result;
+}
+
+/**
+ * Reads a string, number or boolean as text
+ * @param small where numbers and booleans are copied to
+ * @param size size of small
+ * @return the text of the value
+*/
+static char* readScalar(JsonReader *r, char *small, int size) {
+    skipSpace(r);
+    if (*r->pos == '"') return readString(r);
+    int len = 0;
+    while (isalnum((unsigned char) r->pos[len]) || r->pos[len] == '-' || r->pos[len] == '+'
+           || r->pos[len] == '.') len++;
+    if (len == 0 || len >= size) jsonError(r, "Expected a string, number or boolean");
+    memcpy(small, r->pos, len);
+    small[len] = '\0';
+    r->pos += len;
+    return small;
+}
+
+/**
+ * Reads {"id": n, "messages": n, "queue_size": n}
+*/
+static void readProducer(JsonReader *r) {
+    SizeAndMessages *producer = addProducer(r->p, r->p->data->numOfProducers + 1);
+    char small[64];
+    int count = 0;
+    expectChar(r, '{');
+    while (nextMember(r, '}', &count)) {
+        char *key = readString(r);
+        expectChar(r, ':');
+        char *value = readScalar(r, small, sizeof(small));
+        markLine(r);
+        if (strcmp(key, "id") == 0) {
+            producer->producerId = (int) parseInteger(r->p, key, value, 0, INT_MAX);
+        } else if (strcmp(key, "messages") == 0) {
+            producer->numOfMessages = (int) parseInteger(r->p, key, value, 0, INT_MAX);
+        } else if (strcmp(key, "queue_size") == 0) {
+            producer->queueSize = (int) parseInteger(r->p, key, value, 1, INT_MAX);
+        } else {
+            jsonError(r, "Unknown producer setting");
+        }
+    }
+    if (producer->numOfMessages < 0 || producer->queueSize < 0)
+        jsonError(r, "A producer needs both messages and queue_size");
+}
+
+/**
+ * Reads {"name": "...", "co_editors": n, ...}, the name must come first
+*/
+static void readCategory(JsonReader *r) {
+    char small[64];
+    int count = 0;
+    expectChar(r, '{');
+    if (!nextMember(r, '}', &count) || strcmp(readString(r), "name") != 0)
+        jsonError(r, "A category must start with its name");
+    expectChar(r, ':');
+    CategoryInfo *info = addCategory(r->p, readString(r));
+
+    while (nextMember(r, '}', &count)) {
+        char *key = readString(r);
+        expectChar(r, ':');
+        const CategorySetting *setting = findCategorySetting(key, 1);
+        if (setting == NULL) jsonError(r, "Unknown category setting");
+        char *value = readScalar(r, small, sizeof(small));
+        markLine(r);
+        setting->apply(r->p, info, key, value);
+    }
+}
+
+/**
+ * Parses the JSON form:
+ * {"producers": [...], "categories": [...], "co_editor_queue_size": n, ...}
+ * every top level setting of the text form has a snake_case JSON name
+*/
+static void parseJson(ConfigParser *p, char *text) {
+    JsonReader r = { p, text, text };
+    p->line++;
+    char small[64];
+    int count = 0;
+
+    expectChar(&r, '{');
+    while (nextMember(&r, '}', &count)) {
+        char *key = readString(&r);
+        expectChar(&r, ':');
+        if (strcmp(key, "producers") == 0 || strcmp(key, "categories") == 0) {
+            int isProducers = key[0] == 'p';
+            int items = 0;
+            expectChar(&r, '[');
+            while (nextMember(&r, ']', &items)) {
+                if (isProducers) readProducer(&r);
+                else readCategory(&r);
+            }
+            continue;
+        }
+        const ConfigSetting *setting = findSetting(key, 1);
+        if (setting == NULL) jsonError(&r, "Unknown setting");
+        char *value = readScalar(&r, small, sizeof(small));
+        markLine(&r);
+        setting->apply(p, key, value, setting->arg);
+    }
+    skipSpace(&r);
+    if (*r.pos != '\0') jsonError(&r, "Unexpected text after the config");
+}
+
+/**
+ * Reads the rest of a file into memory, null terminated
+*/
+static char* readAll(ConfigParser *p, FILE *file) {
+    size_t capacity = 64 * 1024, used = 0;
+    char *text = (char*) malloc(capacity);
+    if (text == NULL) configError(p, "Failed to allocate memory");
+    size_t got;
+    while ((got = fread(text + used, 1, capacity - used - 1, file)) > 0) {
+        used += got;
+        if (capacity - used == 1) {
+            capacity *= 2;
+            char *grown = (char*) realloc(text, capacity);
+            if (grown == NULL) configError(p, "Failed to allocate memory");
+            text = grown;
+        }
+    }
+    text[used] = '\0';
+    return text;
+}
+
+/**
+ * Fills the settings that weren't set with their defaults, then makes sure
+ * the pipeline described by the config can actually run
+*/
+static void resolveConfig(ConfigParser *p) {
+    ConfigData *data = p->data;
+    p->line = 0;
+    if (data->numOfProducers == 0) configError(p, "No producers are declared");
+    if (data->coEditorQueueSize == 0) configError(p, "Missing 'Co-Editor queue size'");
+
+    // No categories declared, use the default ones with a single co editor each
+    if (data->numOfCategories == 0) {
+        for (int i = 0; i < NUM_DEFAULT_CATEGORIES; i++) addCategory(p, categoryName(i));
+    }
+
+    // Categories use the global settings for everything they didn't set
+    for (int i = 0; i < data->numOfCategories; i++) {
+        CategoryInfo *info = &data->categoriesInfo[i];
+        if (info->queueSize == 0) info->queueSize = data->coEditorQueueSize;
+        if (info->editCost.mode == -1) info->editCost = data->editCost;
+        if (info->overflowPolicy == -1) info->overflowPolicy = data->overflowPolicy;
+        if (info->overflowSize == 0) info->overflowSize = data->overflowSize;
+        if (info->priority >= data->numOfLanes)
+            configError(p, "Priority of %s is %d, but there are only %d priority lanes",
+                        info->name, info->priority, data->numOfLanes);
+    }
+}
+
+/**
+ * Loads a config file. The JSON form is recognized by its leading '{',
+ * anything else is parsed as the plain text form.
+ * Exits with the file, line and reason if the config is invalid.
+ * @param path path of the config file
+ * @return the config, free it with freeConfigData
+*/
+ConfigData* loadConfig(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Failed to open file: %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    ConfigData *data = (ConfigData*) calloc(1, sizeof(ConfigData));
+    if (data == NULL) {
+        printf("Failed to allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    data->editCost.mode = EDIT_COST_FIXED;
+    data->editCost.usec = DEFAULT_EDIT_COST_USEC;
+    data->numOfDispatchers = 1;
+    data->numOfLanes = 1;
+    parseLaneSchedule("strict", &data->laneSchedule, data->laneWeights);
+    initAffinity(&data->affinity);
+    data->overflowPolicy = OVERFLOW_BLOCK;
+    data->overflowSize = DEFAULT_OVERFLOW_SIZE;
+    data->outputBufferSize = DEFAULT_OUTPUT_BUFFER_SIZE;
+    data->outputLatencyUsec = DEFAULT_OUTPUT_LATENCY_USEC;
+
+    ConfigParser p = { path, 0, data, 0, 0 };
+    int c;
+    while ((c = fgetc(file)) != EOF && isspace(c)) {
+        if (c == '\n') p.line++;
+    }
+    if (c != EOF) ungetc(c, file);
+
+    if (c == '{') {
+        char *text = readAll(&p, file);
+        parseJson(&p, text);
+        free(text);
+    } else {
+        parseText(&p, file);
+    }
+    fclose(file);
+
+    resolveConfig(&p);
+    return data;
+}
+
+/**
+ * Frees the config data and everything it holds
+ */
+void freeConfigData(ConfigData *data) {
+    free(data->producersInfo);
+    free(data->outputTarget);
+    if (data->categoriesInfo != NULL) {
+        for (int i = 0; i < data->numOfCategories; i++)
+            free(data->categoriesInfo[i].name);
+        free(data->categoriesInfo);
+    }
+    free(data);
+}
@@ -0,0 +1,53 @@
+// Yuval Anteby 212152896
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "EditStage.h"
+#include "Affinity.h"
+#include "BoundedBuffer.h"
+
+typedef struct SizeAndMessages {
+    int producerId;
+    int numOfMessages;
+    int queueSize;
+} SizeAndMessages;
+
+typedef struct CategoryInfo {
+    char *name;
+    int numOfCoEditors;
+    int numOfWorkers;       // worker threads per co editor
+    int queueSize;          // 0 until set, then the co editor queue size is used
+    EditCost editCost;      // mode -1 until set, then the global default is used
+    int overflowPolicy;     // -1 until set, then the global default is used
+    int overflowSize;       // 0 until set, then the global default is used
+    int priority;           // Lane of its messages in the mixed buffers, 0 is the lowest
+} CategoryInfo;
+
+typedef struct ConfigData {
+    int numOfProducers;
+    SizeAndMessages *producersInfo;
+    int numOfCategories;
+    CategoryInfo *categoriesInfo;
+    int coEditorQueueSize;
+    EditCost editCost;
+    int overflowPolicy;
+    int overflowSize;
+    int numOfDispatchers;
+    int numOfLanes;             // Priority lanes of the producer and screen buffers
+    int laneSchedule;           // One of LaneSchedule
+    int laneWeights[MAX_PRIORITY_LANES];
+    int producerProcesses;      // 1 to run every producer in its own process
+    Affinity affinity;          // CPUs every kind of thread is pinned to
+    char *outputTarget;         // "stdout", "fd <n>" or a file path
+    int outputBufferSize;
+    long long outputLatencyUsec;
+} ConfigData;
+
+// Loads a config file, plain text or JSON, exits with a clear message if it's invalid
+ConfigData* loadConfig(const char *path);
+
+// Frees the config data and everything it holds
+void freeConfigData(ConfigData *data);
+
+#endif
@@ -0,0 +1,211 @@
+// Yuval Anteby 212152896
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Dispatcher.h"
+
+/**
+ * Initializes the shared dispatcher state
+ * @param producers buffers of all the producers
+ * @param shmProducers shared memory buffers of all the producers when they run
+ *        as separate processes, NULL when they are threads
+ * @param producersCount number of producers
+ * @param categoryBufs buffer of every category
+ * @param overflows overflow queue of every category
+ * @param numOfCategories number of categories
+ * @param numOfDispatchers number of dispatcher threads that will share it
+ * @param signal notified by every producer buffer on inserts and closing, and by
+ *        the category buffers that have an overflow queue on removes
+ * @return pointer to the shared state, or NULL on failure
+*/
+DispatchShared* initDispatchShared(BoundedBuffer** producers, ShmBuffer** shmProducers, int producersCount,
+                                   BoundedBuffer** categoryBufs, OverflowQueue** overflows,
+                                   int numOfCategories, int numOfDispatchers, BufferSignal* signal) {
+    DispatchShared* shared = (DispatchShared*) malloc(sizeof(DispatchShared));
+    if (shared == NULL) return NULL;
+    shared->claims = (atomic_int*) malloc(sizeof(atomic_int) * (producersCount > 0 ? producersCount : 1));
+    shared->producerDone = (int*) calloc(producersCount > 0 ? producersCount : 1, sizeof(int));
+    shared->categoryLocks = (pthread_mutex_t*) malloc(sizeof(pthread_mutex_t) * numOfCategories);
+    if (shared->claims == NULL || shared->producerDone == NULL || shared->categoryLocks == NULL) {
+        free(shared->claims);
+        free(shared->producerDone);
+        free(shared->categoryLocks);
+        free(shared);
+        return NULL;
+    }
+
+    shared->producers = producers;
+    shared->shmProducers = shmProducers;
+    shared->producersCount = producersCount;
+    for (int i = 0; i < producersCount; i++) atomic_init(&shared->claims[i], 0);
+    atomic_init(&shared->doneProducers, 0);
+    atomic_init(&shared->activeDispatchers, numOfDispatchers);
+    shared->signal = signal;
+
+    shared->categoryBufs = categoryBufs;
+    shared->overflows = overflows;
+    shared->numOfCategories = numOfCategories;
+    for (int c = 0; c < numOfCategories; c++) pthread_mutex_init(&shared->categoryLocks[c], NULL);
+
+    atomic_init(&shared->steals, 0);
+    return shared;
+}
+
+/**
+ * Takes the next message of a producer without blocking
+ * @param status set to BUFFER_OK, BUFFER_TIMEOUT if there is nothing yet,
+ *        or BUFFER_CLOSED once the producer is done
+ * @return the message, or NULL if there is none
+*/
+static Message* takeFromProducer(DispatchShared* shared, int i, int* status) {
+    if (shared->shmProducers == NULL) return removeFromBufferTimed(shared->producers[i], 0, status);
+
+    // Copy the message out of the shared segment, and only allocate once there
+    // was one: an idle producer is polled far more often than it has messages
+    Message taken;
+    *status = removeFromShmBuffer(shared->shmProducers[i], &taken, 0);
+    if (*status != BUFFER_OK) return NULL;
+
+    // The rest of the pipeline owns the message from here
+    Message* message = (Message*) malloc(sizeof(Message));
+    if (message == NULL) {
+        printf("Failed to allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *message = taken;
+    return message;
+}
+
+/**
+ * Claims a producer and moves up to DISPATCH_BATCH of its messages
+ * to their category buffers
+ * @param shared the shared dispatcher state
+ * @param i index of the producer
+ * @return number of messages taken from the producer
+*/
+static int dispatchFrom(DispatchShared* shared, int i) {
+    int expected = 0;
+    // Someone else is working on this producer, leave it to them
+    if (!atomic_compare_exchange_strong(&shared->claims[i], &expected, 1)) return 0;
+
+    int moved = 0;
+    while (!shared->producerDone[i] && moved < DISPATCH_BATCH) {
+        int status;
+        Message* message = takeFromProducer(shared, i, &status);
+        if (status == BUFFER_CLOSED) {
+            // The producer closed its buffer and everything in it was dispatched
+            shared->producerDone[i] = 1;
+            // The other dispatchers may be asleep, wake them up to leave
+            if (atomic_fetch_add(&shared->doneProducers, 1) + 1 == shared->producersCount)
+                notifySignal(shared->signal);
+            moved++;
+            break;
+        }
+        if (message == NULL) break;
+        moved++;
+
+        // route by the category in the header, no string scanning
+        int c = message->category;
+        pthread_mutex_lock(&shared->categoryLocks[c]);
+        dispatchMessage(shared->overflows[c], shared->categoryBufs[c], message);
+        pthread_mutex_unlock(&shared->categoryLocks[c]);
+    }
+
+    atomic_store(&shared->claims[i], 0);
+    return moved;
+}
+
+/**
+ * Sends every message that waited aside, then closes every category buffer
+ * so its co editors stop once they got the rest of it
+*/
+static void endAllCategories(DispatchShared* shared) {
+    for (int c = 0; c < shared->numOfCategories; c++) {
+        pthread_mutex_lock(&shared->categoryLocks[c]);
+        flushOverflow(shared->overflows[c], shared->categoryBufs[c]);
+        closeBuffer(shared->categoryBufs[c]);
+        pthread_mutex_unlock(&shared->categoryLocks[c]);
+    }
+}
+
+/**
+ * Goes over the producers once, its own shard first and the other shards
+ * only when its own had nothing, then drains the overflow queues
+ * @return 1 if anything was moved, 0 otherwise
+*/
+static int dispatchRound(DispatchShared* shared, int start, int end) {
+    int didSomething = 0;
+
+    for (int i = start; i < end; i++) {
+        if (dispatchFrom(shared, i) > 0) didSomething = 1;
+    }
+
+    // Our own shard is idle, help the busy ones
+    if (didSomething == 0) {
+        for (int k = 0; k < shared->producersCount; k++) {
+            int i = (end + k) % shared->producersCount;
+            if (i >= start && i < end) continue;
+            if (dispatchFrom(shared, i) > 0) {
+                didSomething = 1;
+                atomic_fetch_add(&shared->steals, 1);
+            }
+        }
+    }
+
+    // Move messages that waited aside into buffers that have room now
+    for (int c = 0; c < shared->numOfCategories; c++) {
+        if (pthread_mutex_trylock(&shared->categoryLocks[c]) != 0) continue;
+        if (drainOverflow(shared->overflows[c], shared->categoryBufs[c]) > 0) didSomething = 1;
+        pthread_mutex_unlock(&shared->categoryLocks[c]);
+    }
+    return didSomething;
+}
+
+/**
+ * Moves messages from producers to the correct category buffers.
+ * Every dispatcher serves its own shard of producers first, and when
+ * the shard has nothing to offer it steals work from the other shards.
+ * A full category buffer doesn't stall the others, its messages wait in the
+ * category overflow queue (unless its policy is to block).
+ * With nothing to do it sleeps on the shared signal until a producer inserts
+ * or closes, or a category buffer with waiting messages gets room.
+ * The last dispatcher to finish closes every category buffer.
+*/
+void* dispatcherFunc(void* arg) {
+    ForDispatcher* forDispatcher = (ForDispatcher*)arg;
+    DispatchShared* shared = forDispatcher->shared;
+    int start = forDispatcher->shardStart;
+    int end = forDispatcher->shardEnd;
+
+    while (atomic_load(&shared->doneProducers) < shared->producersCount) {
+        if (dispatchRound(shared, start, end)) continue;
+
+        // Announce the sleep first and only then look once more, so whatever
+        // arrived before the announcement is found now and the rest wakes us
+        long long seen = prepareSignalWait(shared->signal);
+        if (dispatchRound(shared, start, end) == 0
+            && atomic_load(&shared->doneProducers) < shared->producersCount)
+            waitForSignal(shared->signal, seen);
+        else
+            cancelSignalWait(shared->signal);
+    }
+
+    // Every producer is done, only the last dispatcher out closes the categories
+    if (atomic_fetch_sub(&shared->activeDispatchers, 1) == 1) endAllCategories(shared);
+    return NULL;
+}
+
+/**
+ * Destroys the shared dispatcher state
+ * @param shared pointer to the shared state
+*/
+void destroyDispatchShared(DispatchShared* shared) {
+    if (shared) {
+        for (int c = 0; c < shared->numOfCategories; c++)
+            pthread_mutex_destroy(&shared->categoryLocks[c]);
+        free(shared->categoryLocks);
+        free(shared->claims);
+        free(shared->producerDone);
+        free(shared);
+    }
+}
@@ -0,0 +1,59 @@
+// Yuval Anteby 212152896
+
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include "BoundedBuffer.h"
+#include "Overflow.h"
+#include "ShmBuffer.h"
+
+// How many messages a dispatcher moves from a producer before letting go of it
+#define DISPATCH_BATCH 16
+
+/**
+ * State shared by all the dispatcher threads.
+ * Every producer buffer is owned by the shard of one dispatcher, but any
+ * dispatcher may claim it for a while; the claim keeps a single dispatcher
+ * on a producer at a time, so its messages stay in order.
+*/
+typedef struct DispatchShared {
+    BoundedBuffer** producers;
+    ShmBuffer** shmProducers;       // Used instead of producers when they run as processes
+    int producersCount;
+    atomic_int* claims;             // 1 while some dispatcher works on the producer
+    int* producerDone;              // The producer's buffer was closed and drained, guarded by the claim
+    atomic_int doneProducers;       // Producers whose closed buffer was drained
+    atomic_int activeDispatchers;   // The last one to leave closes the categories
+    BufferSignal* signal;           // Producers and category buffers with room wake idle dispatchers
+
+    BoundedBuffer** categoryBufs;
+    OverflowQueue** overflows;
+    pthread_mutex_t* categoryLocks; // Guard the overflow queue and order of each category
+    int numOfCategories;
+
+    atomic_llong steals;            // Batches taken from another dispatcher's shard
+} DispatchShared;
+
+/**
+ * Arguments of a single dispatcher thread
+*/
+typedef struct ForDispatcher {
+    DispatchShared* shared;
+    int shardStart;                 // Producers [shardStart, shardEnd) are this dispatcher's own
+    int shardEnd;
+} ForDispatcher;
+
+// Initializes the shared dispatcher state
+DispatchShared* initDispatchShared(BoundedBuffer** producers, ShmBuffer** shmProducers, int producersCount,
+                                   BoundedBuffer** categoryBufs, OverflowQueue** overflows,
+                                   int numOfCategories, int numOfDispatchers, BufferSignal* signal);
+
+// Dispatcher thread function
+void* dispatcherFunc(void* arg);
+
+// Destroys the shared dispatcher state
+void destroyDispatchShared(DispatchShared* shared);
+
+#endif
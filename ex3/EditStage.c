@@ -0,0 +1,75 @@
+// Yuval Anteby 212152896
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "EditStage.h"
+
+// Every worker thread draws its delays from its own seed
+static __thread unsigned int editSeed = 0;
+
+/**
+ * Returns the delay of a single edit in microseconds
+ * @param cost the configured cost
+ * @return delay in microseconds
+*/
+static long drawEditDelay(const EditCost *cost) {
+    if (editSeed == 0) editSeed = (unsigned int) time(NULL) ^ (unsigned int) pthread_self();
+
+    switch (cost->mode) {
+        case EDIT_COST_FIXED:
+            return cost->usec;
+        case EDIT_COST_UNIFORM:
+            return rand_r(&editSeed) % (2L * cost->usec + 1);
+        case EDIT_COST_EXPONENTIAL: {
+            // inverse transform sampling, u is in (0, 1]
+            double u = (rand_r(&editSeed) + 1.0) / ((double) RAND_MAX + 1.0);
+            return (long) (-log(u) * cost->usec);
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Edit callback that only simulates work by sleeping
+ * @param msg the message being edited
+ * @param arg pointer to the EditCost to simulate
+*/
+void simulatedEdit(Message *msg, void *arg) {
+    (void) msg;
+    long delay = drawEditDelay((const EditCost*) arg);
+    if (delay > 0) usleep(delay);
+}
+
+/**
+ * Parses an edit cost description
+ * @param text "<none|fixed|uniform|exponential> [usec]"
+ * @param cost output cost
+ * @return 0 on success, -1 if the text is not a valid cost
+*/
+int parseEditCost(const char *text, EditCost *cost) {
+    char mode[32];
+    int usec = 0;
+    int fields = sscanf(text, "%31s %d", mode, &usec);
+    if (fields < 1) return -1;
+
+    if (strcmp(mode, "none") == 0) {
+        cost->mode = EDIT_COST_NONE;
+        cost->usec = 0;
+        return 0;
+    }
+    if (fields < 2 || usec < 0) return -1;
+
+    if (strcmp(mode, "fixed") == 0) cost->mode = EDIT_COST_FIXED;
+    else if (strcmp(mode, "uniform") == 0) cost->mode = EDIT_COST_UNIFORM;
+    else if (strcmp(mode, "exponential") == 0) cost->mode = EDIT_COST_EXPONENTIAL;
+    else return -1;
+
+    cost->usec = usec;
+    return 0;
+}
@@ -0,0 +1,43 @@
+// Yuval Anteby 212152896
+
+#ifndef EDIT_STAGE_H
+#define EDIT_STAGE_H
+
+#include "Message.h"
+
+// Cost of an edit when the config file doesn't set one (the original 100ms)
+#define DEFAULT_EDIT_COST_USEC 100000
+
+/**
+ * How long the simulated edit of a single message takes
+*/
+typedef enum EditCostMode {
+    EDIT_COST_NONE = 0,         // No delay at all
+    EDIT_COST_FIXED,            // Always usec microseconds
+    EDIT_COST_UNIFORM,          // Uniformly distributed in [0, 2 * usec]
+    EDIT_COST_EXPONENTIAL       // Exponentially distributed with mean usec
+} EditCostMode;
+
+typedef struct EditCost {
+    int mode;
+    int usec;
+} EditCost;
+
+// Callback that edits a single message
+typedef void (*EditFunc)(Message *msg, void *arg);
+
+/**
+ * A pluggable edit step, the co editors call edit(msg, arg) for every message
+*/
+typedef struct EditStage {
+    EditFunc edit;
+    void *arg;
+} EditStage;
+
+// Edit callback that only simulates work, arg is an EditCost*
+void simulatedEdit(Message *msg, void *arg);
+
+// Parses "<none|fixed|uniform|exponential> [usec]" into cost
+int parseEditCost(const char *text, EditCost *cost);
+
+#endif
@@ -0,0 +1,66 @@
+// Yuval Anteby 212152896
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "Message.h"
+
+static const char *defaultCategoryNames[NUM_DEFAULT_CATEGORIES] = {
+    [SPORTS] = "SPORTS",
+    [NEWS] = "NEWS",
+    [WEATHER] = "WEATHER",
+};
+
+static const char **categoryNames = defaultCategoryNames;
+static int numOfCategories = NUM_DEFAULT_CATEGORIES;
+
+/**
+ * Allocates a new message
+ * @param category category of the message
+ * @param producerId id of the producer
+ * @param seq sequence number of the message inside its category
+ * @return pointer to the new message, or NULL if allocation failed
+*/
+Message* createMessage(int category, int producerId, int seq) {
+    Message *msg = (Message*) malloc(sizeof(Message));
+    if (msg == NULL) return NULL;
+    msg->category = category;
+    msg->producerId = producerId;
+    msg->seq = seq;
+    msg->categorySeq = 0;
+    msg->priority = 0;
+    msg->createdNs = 0;
+    return msg;
+}
+
+/**
+ * Sets the category names used when formatting messages.
+ * Must be called before the pipeline threads start, the names are not copied.
+ * @param names array of category names, indexed by category
+ * @param count number of categories
+*/
+void setCategoryNames(const char **names, int count) {
+    categoryNames = names;
+    numOfCategories = count;
+}
+
+/**
+ * Returns the printable name of a category
+ * @param category the category
+ * @return name of the category, or "UNKNOWN" for an invalid one
+*/
+const char* categoryName(int category) {
+    if (category < 0 || category >= numOfCategories) return "UNKNOWN";
+    return categoryNames[category];
+}
+
+/**
+ * Formats the message text into out
+ * @param msg the message to format
+ * @param out output buffer
+ * @param outLen size of the output buffer
+ * @return number of characters written (not including the null terminator)
+*/
+int formatMessage(const Message *msg, char *out, size_t outLen) {
+    return snprintf(out, outLen, "producer %d %s %d",
+                    msg->producerId, categoryName(msg->category), msg->seq);
+}
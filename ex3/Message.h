@@ -0,0 +1,45 @@
+// Yuval Anteby 212152896
+
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+#include <stddef.h>
+
+#define MAX_MSG_LEN 256
+
+/**
+ * Default categories, used when the config file doesn't declare any
+*/
+typedef enum Category {
+    SPORTS = 0,
+    NEWS,
+    WEATHER,
+    NUM_DEFAULT_CATEGORIES
+} Category;
+
+/**
+ * Compact binary message passed between the pipeline stages.
+ * The text is only built by the screen manager, right before printing.
+*/
+typedef struct Message {
+    int category;       // Index of the message category
+    int producerId;     // Id of the producer that created the message
+    int seq;            // Per producer, per category sequence number
+    int categorySeq;    // Order inside the category buffer, set by the dispatcher
+    int priority;       // Lane of the message in buffers with priority lanes, higher is more urgent
+    long long createdNs;// Monotonic time the message was created at
+} Message;
+
+// Allocates a new message
+Message* createMessage(int category, int producerId, int seq);
+
+// Sets the category names used when formatting messages
+void setCategoryNames(const char **names, int count);
+
+// Returns the printable name of a category
+const char* categoryName(int category);
+
+// Formats the message text into out, returns the length written
+int formatMessage(const Message *msg, char *out, size_t outLen);
+
+#endif
@@ -0,0 +1,182 @@
+// Yuval Anteby 212152896
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "OutputStage.h"
+#include "Bench.h"
+
+/**
+ * Initializes the output stage
+ * @param fd file descriptor to write to
+ * @param bufferSize total size of the output buffer in bytes
+ * @param latencyUsec max time a line may stay buffered, 0 writes every line at once
+ * @return pointer to the initialized output stage, or NULL on failure
+*/
+OutputStage* initOutputStage(int fd, int bufferSize, long long latencyUsec) {
+    OutputStage *out = (OutputStage*) malloc(sizeof(OutputStage));
+    if (out == NULL) return NULL;
+
+    // Every chunk must fit at least one full message
+    out->chunkSize = bufferSize / OUTPUT_CHUNKS;
+    if (out->chunkSize < MAX_MSG_LEN + 1) out->chunkSize = MAX_MSG_LEN + 1;
+    out->buffer = (char*) malloc((size_t) out->chunkSize * OUTPUT_CHUNKS);
+    if (out->buffer == NULL) {
+        free(out);
+        return NULL;
+    }
+    for (int i = 0; i < OUTPUT_CHUNKS; i++) {
+        out->iov[i].iov_base = out->buffer + (size_t) i * out->chunkSize;
+        out->iov[i].iov_len = 0;
+    }
+    out->fd = fd;
+    out->ownsFd = 0;
+    out->currentChunk = 0;
+    out->latencyNs = latencyUsec * 1000;
+    out->oldestNs = 0;
+    return out;
+}
+
+/**
+ * Opens the output described by target
+ * @param target "stdout", "fd <n>" for an already open descriptor, or a file path
+ * @param ownsFd set to 1 if the returned fd was opened here and must be closed
+ * @return the file descriptor, or -1 on failure
+*/
+int openOutputTarget(const char *target, int *ownsFd) {
+    int fd;
+    *ownsFd = 0;
+    if (strcmp(target, "stdout") == 0) return STDOUT_FILENO;
+    if (sscanf(target, "fd %d", &fd) == 1) return fd;
+
+    fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) *ownsFd = 1;
+    return fd;
+}
+
+/**
+ * Returns room for a line of up to maxLen bytes (plus a newline),
+ * moving to the next chunk or flushing when the current one is full
+*/
+static char* reserveLine(OutputStage *out, int maxLen) {
+    struct iovec *cur = &out->iov[out->currentChunk];
+    if ((int) cur->iov_len + maxLen + 1 > out->chunkSize) {
+        if (out->currentChunk + 1 == OUTPUT_CHUNKS) flushOutput(out);
+        else out->currentChunk++;
+        cur = &out->iov[out->currentChunk];
+    }
+    return (char*) cur->iov_base + cur->iov_len;
+}
+
+/**
+ * Ends a line that was written into the reserved room,
+ * flushes if the oldest buffered line waited long enough
+*/
+static int commitLine(OutputStage *out, char *dst, int len) {
+    dst[len] = '\n';
+    out->iov[out->currentChunk].iov_len += len + 1;
+
+    long long now = nowNs();
+    if (out->oldestNs == 0) out->oldestNs = now;
+    if (now - out->oldestNs >= out->latencyNs) return flushOutput(out);
+    return 0;
+}
+
+/**
+ * Appends a line, a newline is added after it
+ * @param out pointer to the output stage
+ * @param line the text, doesn't have to be null terminated
+ * @param len length of the text
+ * @return 0 on success, -1 if a flush failed
+*/
+int outputLine(OutputStage *out, const char *line, int len) {
+    if (len > out->chunkSize - 1) len = out->chunkSize - 1;
+    char *dst = reserveLine(out, len);
+    memcpy(dst, line, len);
+    return commitLine(out, dst, len);
+}
+
+/**
+ * Formats a message straight into the output buffer, no intermediate copy
+ * @param out pointer to the output stage
+ * @param msg the message to print
+ * @return 0 on success, -1 if a flush failed
+*/
+int outputMessage(OutputStage *out, const Message *msg) {
+    char *dst = reserveLine(out, MAX_MSG_LEN);
+    int len = formatMessage(msg, dst, MAX_MSG_LEN);
+    if (len > MAX_MSG_LEN - 1) len = MAX_MSG_LEN - 1;
+    return commitLine(out, dst, len);
+}
+
+/**
+ * Returns how long the buffered output may still wait before it must be flushed
+ * @param out pointer to the output stage
+ * @return nanoseconds left, 0 if a flush is due, -1 if nothing is buffered
+*/
+long long outputTimeLeftNs(OutputStage *out) {
+    if (out->oldestNs == 0) return -1;
+    long long left = out->oldestNs + out->latencyNs - nowNs();
+    return left > 0 ? left : 0;
+}
+
+/**
+ * Writes everything that is buffered with as few writev calls as possible
+ * @param out pointer to the output stage
+ * @return 0 on success, -1 on a write error
+*/
+int flushOutput(OutputStage *out) {
+    struct iovec iov[OUTPUT_CHUNKS];
+    int count = out->currentChunk + 1;
+    memcpy(iov, out->iov, sizeof(struct iovec) * count);
+    struct iovec *next = iov;
+    int result = 0;
+
+    while (count > 0) {
+        // Skip chunks that were fully written (or never filled)
+        if (next->iov_len == 0) {
+            next++;
+            count--;
+            continue;
+        }
+        ssize_t written = writev(out->fd, next, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            perror("writev");
+            result = -1;
+            break;
+        }
+        // Partial write, advance past what made it out
+        while (written > 0) {
+            size_t step = (size_t) written < next->iov_len ? (size_t) written : next->iov_len;
+            next->iov_base = (char*) next->iov_base + step;
+            next->iov_len -= step;
+            written -= step;
+            if (next->iov_len == 0) {
+                next++;
+                count--;
+            }
+        }
+    }
+
+    for (int i = 0; i <= out->currentChunk; i++) out->iov[i].iov_len = 0;
+    out->currentChunk = 0;
+    out->oldestNs = 0;
+    return result;
+}
+
+/**
+ * Flushes and destroys the output stage, closes the fd if it was opened by us
+ * @param out pointer to the output stage
+*/
+void destroyOutputStage(OutputStage *out) {
+    if (out) {
+        flushOutput(out);
+        if (out->ownsFd) close(out->fd);
+        free(out->buffer);
+        free(out);
+    }
+}
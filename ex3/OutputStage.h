@@ -0,0 +1,50 @@
+// Yuval Anteby 212152896
+
+#ifndef OUTPUT_STAGE_H
+#define OUTPUT_STAGE_H
+
+#include <sys/uio.h>
+#include "Message.h"
+
+// Number of chunks the output buffer is split into, flushed with one writev
+#define OUTPUT_CHUNKS 16
+#define DEFAULT_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define DEFAULT_OUTPUT_LATENCY_USEC 10000
+
+/**
+ * Batches the screen output, lines are formatted into a large buffer
+ * and written with a single writev once it is full or too old
+*/
+typedef struct OutputStage {
+    int fd;                         // Where the output goes
+    int ownsFd;                     // 1 if the fd was opened by us and must be closed
+    char *buffer;                   // OUTPUT_CHUNKS chunks of chunkSize bytes
+    int chunkSize;
+    struct iovec iov[OUTPUT_CHUNKS];
+    int currentChunk;               // Chunk being filled
+    long long latencyNs;            // Max time a line may wait before it's flushed
+    long long oldestNs;             // When the oldest unflushed line was added, 0 if none
+} OutputStage;
+
+// Initializes the output stage on an open file descriptor
+OutputStage* initOutputStage(int fd, int bufferSize, long long latencyUsec);
+
+// Opens the output described by target ("stdout", "fd <n>" or a file path)
+int openOutputTarget(const char *target, int *ownsFd);
+
+// Appends a line (a newline is added), flushes if the buffer is full or too old
+int outputLine(OutputStage *out, const char *line, int len);
+
+// Formats a message straight into the buffer, flushes if the buffer is full or too old
+int outputMessage(OutputStage *out, const Message *msg);
+
+// Returns the ns left until the buffered output must be flushed, -1 if none
+long long outputTimeLeftNs(OutputStage *out);
+
+// Writes everything that is buffered
+int flushOutput(OutputStage *out);
+
+// Flushes and destroys the output stage
+void destroyOutputStage(OutputStage *out);
+
+#endif
@@ -0,0 +1,226 @@
+// Yuval Anteby 212152896
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Overflow.h"
+
+/**
+ * Initializes an overflow queue
+ * @param policy one of OverflowPolicy
+ * @param capacity how many messages drop-oldest keeps aside
+ * @return pointer to the initialized queue, or NULL on failure
+*/
+OverflowQueue* initOverflowQueue(int policy, int capacity) {
+    OverflowQueue *q = (OverflowQueue*) calloc(1, sizeof(OverflowQueue));
+    if (q == NULL) return NULL;
+    q->policy = policy;
+
+    if (policy == OVERFLOW_DROP_OLDEST) {
+        q->capacity = capacity > 0 ? capacity : 1;
+        q->ring = (Message**) malloc(sizeof(Message*) * q->capacity);
+        if (q->ring == NULL) {
+            free(q);
+            return NULL;
+        }
+    } else if (policy == OVERFLOW_SPILL) {
+        // tmpfile() is already unlinked, it goes away with the process
+        q->spillFile = tmpfile();
+        if (q->spillFile == NULL) {
+            perror("tmpfile");
+            free(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+/**
+ * Parses an overflow policy name
+ * @param text "block", "drop-oldest" or "spill", leading spaces are skipped
+ * @return the policy, or -1 if unknown
+*/
+int parseOverflowPolicy(const char *text) {
+    while (*text == ' ') text++;
+    if (strncmp(text, "block", 5) == 0) return OVERFLOW_BLOCK;
+    if (strncmp(text, "drop-oldest", 11) == 0) return OVERFLOW_DROP_OLDEST;
+    if (strncmp(text, "spill", 5) == 0) return OVERFLOW_SPILL;
+    return -1;
+}
+
+/**
+ * Returns the name of a policy
+*/
+const char* overflowPolicyName(int policy) {
+    switch (policy) {
+        case OVERFLOW_BLOCK: return "block";
+        case OVERFLOW_DROP_OLDEST: return "drop-oldest";
+        case OVERFLOW_SPILL: return "spill";
+        default: return "unknown";
+    }
+}
+
+/**
+ * Returns how many messages are waiting in the overflow queue
+*/
+long long overflowDepth(OverflowQueue *q) {
+    long long spilled = (q->spillWritePos - q->spillReadPos) / (long long) sizeof(Message);
+    return q->count + spilled + (q->spillHead != NULL);
+}
+
+/**
+ * Stamps the message with its category order and tries to insert it
+ * @return 1 if the message is in the buffer, 0 if the buffer is full
+*/
+static int tryInsertInOrder(OverflowQueue *q, BoundedBuffer *bb, Message *msg) {
+    msg->categorySeq = q->nextSeq;
+    if (tryInsertToBuffer(bb, msg) != 0) return 0;
+    q->nextSeq++;
+    q->routed++;
+    return 1;
+}
+
+/**
+ * Returns the oldest waiting message without removing it, NULL if none
+*/
+static Message* peekOverflow(OverflowQueue *q) {
+    if (q->count > 0) return q->ring[q->head];
+    if (q->spillHead != NULL) return q->spillHead;
+    if (q->spillReadPos == q->spillWritePos) return NULL;
+
+    Message *msg = (Message*) malloc(sizeof(Message));
+    if (msg == NULL) return NULL;
+    if (pread(fileno(q->spillFile), msg, sizeof(Message), q->spillReadPos) != sizeof(Message)) {
+        perror("pread");
+        free(msg);
+        return NULL;
+    }
+    q->spillReadPos += sizeof(Message);
+    // Everything was read back, start the file over so it doesn't keep growing
+    if (q->spillReadPos == q->spillWritePos) {
+        if (ftruncate(fileno(q->spillFile), 0) != 0) perror("ftruncate");
+        q->spillReadPos = 0;
+        q->spillWritePos = 0;
+    }
+    q->spillHead = msg;
+    return msg;
+}
+
+/**
+ * Forgets the oldest waiting message, after it was inserted to the buffer
+*/
+static void popOverflow(OverflowQueue *q) {
+    if (q->count > 0) {
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+    } else {
+        q->spillHead = NULL;
+    }
+}
+
+/**
+ * Keeps a message aside according to the policy
+ * @return 0 on success, -1 if it couldn't be kept aside
+*/
+static int pushOverflow(OverflowQueue *q, Message *msg) {
+    if (q->policy == OVERFLOW_DROP_OLDEST) {
+        if (q->count == q->capacity) {
+            free(q->ring[q->head]);
+            q->head = (q->head + 1) % q->capacity;
+            q->count--;
+            q->dropped++;
+        }
+        q->ring[(q->head + q->count) % q->capacity] = msg;
+        q->count++;
+        return 0;
+    }
+
+    if (pwrite(fileno(q->spillFile), msg, sizeof(Message), q->spillWritePos) != sizeof(Message)) {
+        perror("pwrite");
+        return -1;
+    }
+    q->spillWritePos += sizeof(Message);
+    q->spilled++;
+    free(msg);
+    return 0;
+}
+
+/**
+ * Sends a message to its category buffer. If the buffer is full the message
+ * waits in the overflow queue, unless the policy is to block.
+ * Messages never overtake the ones already waiting, so the category stays in order.
+ * @param q overflow queue of the category
+ * @param bb buffer of the category
+ * @param msg message to send
+*/
+void dispatchMessage(OverflowQueue *q, BoundedBuffer *bb, Message *msg) {
+    if (q->policy == OVERFLOW_BLOCK) {
+        msg->categorySeq = q->nextSeq++;
+        q->routed++;
+        insertToBuffer(bb, msg);
+        return;
+    }
+
+    if (overflowDepth(q) == 0 && tryInsertInOrder(q, bb, msg)) return;
+
+    q->overflowed++;
+    if (pushOverflow(q, msg) != 0) {
+        // Couldn't put it aside, fall back to blocking
+        flushOverflow(q, bb);
+        msg->categorySeq = q->nextSeq++;
+        q->routed++;
+        insertToBuffer(bb, msg);
+        return;
+    }
+    long long depth = overflowDepth(q);
+    if (depth > q->maxDepth) q->maxDepth = depth;
+}
+
+/**
+ * Moves waiting messages into the buffer until it is full, without blocking
+ * @param q overflow queue of the category
+ * @param bb buffer of the category
+ * @return how many messages were moved
+*/
+int drainOverflow(OverflowQueue *q, BoundedBuffer *bb) {
+    int moved = 0;
+    Message *msg;
+    while ((msg = peekOverflow(q)) != NULL && tryInsertInOrder(q, bb, msg)) {
+        popOverflow(q);
+        moved++;
+    }
+    return moved;
+}
+
+/**
+ * Moves every waiting message into the buffer, blocking as needed
+ * @param q overflow queue of the category
+ * @param bb buffer of the category
+*/
+void flushOverflow(OverflowQueue *q, BoundedBuffer *bb) {
+    Message *msg;
+    while ((msg = peekOverflow(q)) != NULL) {
+        popOverflow(q);
+        msg->categorySeq = q->nextSeq++;
+        q->routed++;
+        insertToBuffer(bb, msg);
+    }
+}
+
+/**
+ * Destroys the overflow queue, frees memory and removes the spill file
+ * @param q pointer to the queue
+*/
+void destroyOverflowQueue(OverflowQueue *q) {
+    if (q) {
+        while (q->count > 0) {
+            free(q->ring[q->head]);
+            q->head = (q->head + 1) % q->capacity;
+            q->count--;
+        }
+        free(q->spillHead);
+        if (q->spillFile) fclose(q->spillFile);
+        free(q->ring);
+        free(q);
+    }
+}
@@ -0,0 +1,70 @@
+// Yuval Anteby 212152896
+
+#ifndef OVERFLOW_H
+#define OVERFLOW_H
+
+#include <stdio.h>
+#include "BoundedBuffer.h"
+
+#define DEFAULT_OVERFLOW_SIZE 1024
+
+/**
+ * What the dispatcher does when a category buffer is full
+*/
+typedef enum OverflowPolicy {
+    OVERFLOW_BLOCK = 0,         // Wait for room, stalls every other category
+    OVERFLOW_DROP_OLDEST,       // Keep up to capacity messages aside, drop the oldest beyond that
+    OVERFLOW_SPILL              // Keep every message aside in a temporary file
+} OverflowPolicy;
+
+/**
+ * Messages of a single category that didn't fit in its buffer yet.
+ * It has no lock of its own, every dispatcher thread that uses it holds
+ * categoryLocks[c] of its category (see DispatchShared).
+*/
+typedef struct OverflowQueue {
+    int policy;
+    int nextSeq;                // categorySeq of the next message to enter the category buffer
+
+    Message **ring;             // In memory messages (drop-oldest)
+    int capacity;
+    int head;
+    int count;
+
+    FILE *spillFile;            // Spilled messages (spill), stored as raw Message records
+    long long spillReadPos;
+    long long spillWritePos;
+    Message *spillHead;         // Read back from the file but not inserted yet
+
+    long long routed;           // Metrics
+    long long overflowed;
+    long long dropped;
+    long long spilled;
+    long long maxDepth;
+} OverflowQueue;
+
+// Initializes an overflow queue
+OverflowQueue* initOverflowQueue(int policy, int capacity);
+
+// Parses "block", "drop-oldest" or "spill", returns -1 if unknown
+int parseOverflowPolicy(const char *text);
+
+// Returns the name of a policy
+const char* overflowPolicyName(int policy);
+
+// Returns how many messages are waiting in the overflow queue
+long long overflowDepth(OverflowQueue *q);
+
+// Sends a message to its category buffer, or aside if the buffer is full
+void dispatchMessage(OverflowQueue *q, BoundedBuffer *bb, Message *msg);
+
+// Moves waiting messages into the buffer without blocking, returns how many moved
+int drainOverflow(OverflowQueue *q, BoundedBuffer *bb);
+
+// Moves every waiting message into the buffer, blocking as needed
+void flushOverflow(OverflowQueue *q, BoundedBuffer *bb);
+
+// Destroys the overflow queue, frees memory and removes the spill file
+void destroyOverflowQueue(OverflowQueue *q);
+
+#endif
@@ -0,0 +1,70 @@
+// Yuval Anteby 212152896
+
+#include <stdlib.h>
+#include "ReorderBuffer.h"
+
+/**
+ * Initializes the reorder buffer
+ * @param window number of messages that may finish ahead of the oldest one
+ * @param out buffer that receives the messages in order
+ * @return pointer to the initialized reorder buffer, or NULL on failure
+*/
+ReorderBuffer* initReorderBuffer(int window, BoundedBuffer *out) {
+    ReorderBuffer *rb = (ReorderBuffer*) malloc(sizeof(ReorderBuffer));
+    if (rb == NULL) return NULL;
+    rb->slots = (Message**) calloc(window, sizeof(Message*));
+    if (rb->slots == NULL) {
+        free(rb);
+        return NULL;
+    }
+    rb->window = window;
+    rb->nextSeq = 0;
+    rb->out = out;
+
+    pthread_mutex_init(&rb->lock, NULL);
+    pthread_cond_init(&rb->slotFreed, NULL);
+
+    return rb;
+}
+
+/**
+ * Hands over an edited message. Blocks while the message is too far
+ * ahead of the oldest unfinished one, then forwards every message
+ * that is next in line to the output buffer.
+ * @param rb pointer to the reorder buffer
+ * @param msg edited message, its categorySeq decides its turn
+*/
+void insertInOrder(ReorderBuffer *rb, Message *msg) {
+    pthread_mutex_lock(&rb->lock);
+    // The worker holding nextSeq never waits here, so this always progresses
+    while (msg->categorySeq >= rb->nextSeq + rb->window)
+        pthread_cond_wait(&rb->slotFreed, &rb->lock);
+
+    rb->slots[msg->categorySeq % rb->window] = msg;
+
+    int forwarded = 0;
+    int slot = rb->nextSeq % rb->window;
+    while (rb->slots[slot] != NULL) {
+        insertToBuffer(rb->out, rb->slots[slot]);
+        rb->slots[slot] = NULL;
+        rb->nextSeq++;
+        slot = rb->nextSeq % rb->window;
+        forwarded = 1;
+    }
+
+    if (forwarded) pthread_cond_broadcast(&rb->slotFreed);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+/**
+ * Destroys the reorder buffer and frees memory
+ * @param rb pointer to the reorder buffer
+*/
+void destroyReorderBuffer(ReorderBuffer *rb) {
+    if (rb) {
+        pthread_mutex_destroy(&rb->lock);
+        pthread_cond_destroy(&rb->slotFreed);
+        free(rb->slots);
+        free(rb);
+    }
+}
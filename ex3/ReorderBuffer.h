@@ -0,0 +1,31 @@
+// Yuval Anteby 212152896
+
+#ifndef REORDER_BUFFER_H
+#define REORDER_BUFFER_H
+
+#include <pthread.h>
+#include "BoundedBuffer.h"
+
+/**
+ * Puts the messages of a single category back in dispatch order
+ * after they were edited in parallel by several workers
+*/
+typedef struct ReorderBuffer {
+    Message **slots;            // Finished messages waiting for their turn
+    int window;                 // How far ahead of nextSeq a message may finish
+    int nextSeq;                // categorySeq of the next message to forward
+    BoundedBuffer *out;         // Where the ordered messages go
+    pthread_mutex_t lock;
+    pthread_cond_t slotFreed;
+} ReorderBuffer;
+
+// Initializes the reorder buffer
+ReorderBuffer* initReorderBuffer(int window, BoundedBuffer *out);
+
+// Hands over an edited message, forwards every message that is now in order
+void insertInOrder(ReorderBuffer *rb, Message *msg);
+
+// Destroys the reorder buffer and frees memory
+void destroyReorderBuffer(ReorderBuffer *rb);
+
+#endif
@@ -0,0 +1,222 @@
+// Yuval Anteby 212152896
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ShmBuffer.h"
+
+/**
+ * Maps an open segment and wraps it in a ShmBuffer
+ * @return the buffer, or NULL on failure (the fd is closed either way)
+*/
+static ShmBuffer* mapSegment(int fd, const char *name, size_t length, int isOwner) {
+    ShmBuffer *sb = (ShmBuffer*) malloc(sizeof(ShmBuffer));
+    if (sb == NULL) {
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping keeps the segment alive, the fd isn't needed anymore
+    close(fd);
+    if (addr == MAP_FAILED) {
+        perror("mmap");
+        free(sb);
+        return NULL;
+    }
+    sb->segment = (ShmSegment*) addr;
+    sb->length = length;
+    snprintf(sb->name, SHM_NAME_LEN, "%s", name);
+    sb->isOwner = isOwner;
+    sb->signal = NULL;
+    return sb;
+}
+
+/**
+ * Creates a new shared memory buffer
+ * @param name name of the segment, starts with '/', must not exist yet
+ * @param bufferSize number of message slots
+ * @return pointer to the buffer, or NULL on failure
+*/
+ShmBuffer* createShmBuffer(const char *name, int bufferSize) {
+    if (bufferSize < 1 || strlen(name) >= SHM_NAME_LEN) return NULL;
+    size_t length = sizeof(ShmSegment) + sizeof(Message) * (size_t) bufferSize;
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if (ftruncate(fd, length) != 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    ShmBuffer *sb = mapSegment(fd, name, length, 1);
+    if (sb == NULL) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    ShmSegment *seg = sb->segment;
+    seg->size = bufferSize;
+    seg->head = 0;
+    seg->tail = 0;
+    seg->count = 0;
+    seg->isClosed = 0;
+
+    // A process that dies holding the lock must not hang the others
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&seg->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    sem_init(&seg->readSemaphore, 1, 0);
+    sem_init(&seg->writeSemaphore, 1, bufferSize);
+    return sb;
+}
+
+/**
+ * Attaches to a shared memory buffer created by another process
+ * @param name name the buffer was created with
+ * @return pointer to the buffer, or NULL on failure
+*/
+ShmBuffer* openShmBuffer(const char *name) {
+    if (strlen(name) >= SHM_NAME_LEN) return NULL;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ShmSegment)) {
+        close(fd);
+        return NULL;
+    }
+    return mapSegment(fd, name, st.st_size, 0);
+}
+
+/**
+ * Locks the segment, recovering the lock if its holder died.
+ * Only producer processes die on their own, so the holder was in the middle
+ * of an insert: the slot may be copied and tail moved without count, and the
+ * read semaphore misses its post. Nothing after such a death can be trusted
+ * to line up, so count is rebuilt from head and tail (an insert only moves
+ * tail one past what count says), and the segment is closed: nothing more
+ * comes in, and readers stop relying on the semaphore counts.
+*/
+static void lockSegment(ShmSegment *seg) {
+    if (pthread_mutex_lock(&seg->lock) != EOWNERDEAD) return;
+
+    int byIndex = (seg->tail - seg->head + seg->size) % seg->size;
+    // head == tail is either empty or full, count tells which one it was
+    seg->count = byIndex == 0 && seg->count > 0 ? seg->size : byIndex;
+    if (!seg->isClosed) {
+        seg->isClosed = 1;
+        sem_post(&seg->readSemaphore);
+        sem_post(&seg->writeSemaphore);
+    }
+    pthread_mutex_consistent(&seg->lock);
+}
+
+/**
+ * Copies a message into the buffer, waiting at most timeoutUsec for room
+ * @param sb pointer to the buffer
+ * @param msg message to copy
+ * @param timeoutUsec how long to wait, 0 to not wait at all, BUFFER_WAIT_FOREVER to block
+ * @return BUFFER_OK, BUFFER_TIMEOUT or BUFFER_CLOSED
+*/
+int insertToShmBuffer(ShmBuffer *sb, const Message *msg, long long timeoutUsec) {
+    ShmSegment *seg = sb->segment;
+    if (waitSemaphore(&seg->writeSemaphore, timeoutUsec) != 0) return BUFFER_TIMEOUT;
+
+    lockSegment(seg);
+    if (seg->isClosed) {
+        pthread_mutex_unlock(&seg->lock);
+        sem_post(&seg->writeSemaphore);
+        return BUFFER_CLOSED;
+    }
+    seg->slots[seg->tail] = *msg;
+    seg->tail = (seg->tail + 1) % seg->size;
+    seg->count++;
+    pthread_mutex_unlock(&seg->lock);
+
+    sem_post(&seg->readSemaphore);
+    if (sb->signal != NULL) notifySignal(sb->signal);
+    return BUFFER_OK;
+}
+
+/**
+ * Copies a message out of the buffer, waiting at most timeoutUsec for one.
+ * Messages inserted before the buffer was closed are still handed out.
+ * @param sb pointer to the buffer
+ * @param out where to copy the message
+ * @param timeoutUsec how long to wait, 0 to not wait at all, BUFFER_WAIT_FOREVER to block
+ * @return BUFFER_OK, BUFFER_TIMEOUT or BUFFER_CLOSED
+*/
+int removeFromShmBuffer(ShmBuffer *sb, Message *out, long long timeoutUsec) {
+    ShmSegment *seg = sb->segment;
+    if (waitSemaphore(&seg->readSemaphore, timeoutUsec) != 0) return BUFFER_TIMEOUT;
+
+    lockSegment(seg);
+    if (seg->count == 0) {
+        // Woken up on an empty buffer, so it was closed
+        pthread_mutex_unlock(&seg->lock);
+        sem_post(&seg->readSemaphore);
+        return BUFFER_CLOSED;
+    }
+    *out = seg->slots[seg->head];
+    seg->head = (seg->head + 1) % seg->size;
+    seg->count--;
+    // A producer that died may have left the semaphore short of what is
+    // still in a closed buffer, pass the wake up on to the next reader
+    if (seg->isClosed) sem_post(&seg->readSemaphore);
+    pthread_mutex_unlock(&seg->lock);
+
+    sem_post(&seg->writeSemaphore);
+    return BUFFER_OK;
+}
+
+/**
+ * Closes the buffer, writers fail from now on and readers get what is left.
+ * Like closeBuffer, a single post wakes every waiter since each one passes it on.
+ * @param sb pointer to the buffer
+*/
+void closeShmBuffer(ShmBuffer *sb) {
+    ShmSegment *seg = sb->segment;
+    lockSegment(seg);
+    int wasClosed = seg->isClosed;
+    seg->isClosed = 1;
+    pthread_mutex_unlock(&seg->lock);
+
+    if (!wasClosed) {
+        sem_post(&seg->readSemaphore);
+        sem_post(&seg->writeSemaphore);
+    }
+    if (sb->signal != NULL) notifySignal(sb->signal);
+}
+
+/**
+ * Unmaps the buffer. The owner also destroys the semaphores and removes
+ * the segment, so it must be the last one to use it.
+ * @param sb pointer to the buffer
+*/
+void destroyShmBuffer(ShmBuffer *sb) {
+    if (sb) {
+        if (sb->isOwner) {
+            pthread_mutex_destroy(&sb->segment->lock);
+            sem_destroy(&sb->segment->readSemaphore);
+            sem_destroy(&sb->segment->writeSemaphore);
+            shm_unlink(sb->name);
+        }
+        munmap(sb->segment, sb->length);
+        free(sb);
+    }
+}
@@ -0,0 +1,60 @@
+// Yuval Anteby 212152896
+
+#ifndef SHM_BUFFER_H
+#define SHM_BUFFER_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include "BoundedBuffer.h"
+
+#define SHM_NAME_LEN 64
+
+/**
+ * The part of a shared memory buffer that lives in the segment itself.
+ * Messages are stored inline, so nothing in it points to process local memory.
+*/
+typedef struct ShmSegment {
+    int size;
+    int head;
+    int tail;
+    int count;
+    int isClosed;
+    pthread_mutex_t lock;       // Process shared and robust
+    sem_t writeSemaphore;       // Process shared
+    sem_t readSemaphore;
+    Message slots[];            // size fixed size message slots
+} ShmSegment;
+
+/**
+ * A bounded buffer in a shm_open segment, usable from several processes.
+ * Every process that uses it has its own ShmBuffer that maps the same segment.
+*/
+typedef struct ShmBuffer {
+    ShmSegment *segment;
+    size_t length;              // Length of the mapping
+    char name[SHM_NAME_LEN];
+    int isOwner;                // The creator destroys the semaphores and unlinks the segment
+    BufferSignal *signal;       // Notified on inserts and closing, NULL for none. Must be
+                                // created before forking the processes that use the buffer
+} ShmBuffer;
+
+// Creates a new shared memory buffer
+ShmBuffer* createShmBuffer(const char *name, int bufferSize);
+
+// Attaches to a shared memory buffer created by another process
+ShmBuffer* openShmBuffer(const char *name);
+
+// Copies a message into the buffer, waiting at most timeoutUsec for room
+int insertToShmBuffer(ShmBuffer *sb, const Message *msg, long long timeoutUsec);
+
+// Copies a message out of the buffer, waiting at most timeoutUsec for one
+int removeFromShmBuffer(ShmBuffer *sb, Message *out, long long timeoutUsec);
+
+// Closes the buffer and wakes everyone waiting on it, in every process
+void closeShmBuffer(ShmBuffer *sb);
+
+// Unmaps the buffer, the owner also removes the segment
+void destroyShmBuffer(ShmBuffer *sb);
+
+#endif
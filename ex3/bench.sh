@@ -0,0 +1,69 @@
+#!/bin/bash
+
+# Runs ex3.out in benchmark mode on growing configurations.
+# Every run prints one JSON line, all of them are appended to the results file.
+# Every configuration runs twice, with the threads floating and pinned to CPUs.
+# Usage: ./bench.sh [results file]   (default: bench_results.jsonl)
+
+results=${1:-bench_results.jsonl}
+
+# Compile the program
+make -s
+
+# Runs to make: "producers messages_per_producer producer_queue category_queue"
+declare -a runs=(
+    "1 10000 10 10"
+    "4 100000 10 10"
+    "4 250000 100 100"
+    "16 62500 100 100"
+    "16 125000 1000 1000"
+    "64 31250 1000 1000"
+)
+
+# Function to generate a benchmark configuration file
+generate_config() {
+    local filename=$1
+    local num_producers=$2
+    local num_messages=$3
+    local producer_queue=$4
+    local category_queue=$5
+    local pinned=$6
+
+    : > "$filename"
+    for ((i=1; i<=num_producers; i++)); do
+        echo -e "PRODUCER $i\n$num_messages\nqueue size = $producer_queue\n" >> "$filename"
+    done
+
+    # No simulated editing, we measure the pipeline itself
+    echo -e "Edit cost = none" >> "$filename"
+    echo -e "Co-Editor queue size = $category_queue" >> "$filename"
+
+    # Producers and dispatchers on the first half of the CPUs, the rest of the
+    # pipeline on the second half, so every queue crosses the halves only once
+    if [ "$pinned" = "1" ]; then
+        local cpus=$(nproc)
+        local half=$((cpus / 2))
+        local first="0-$((half > 0 ? half - 1 : 0))"
+        local second="$half-$((cpus - 1))"
+        echo -e "Producer CPUs = $first" >> "$filename"
+        echo -e "Dispatcher CPUs = $first" >> "$filename"
+        echo -e "Co-Editor CPUs = $second" >> "$filename"
+        echo -e "Screen CPUs = $second" >> "$filename"
+    fi
+}
+
+for run in "${runs[@]}"; do
+    read -r producers messages producer_queue category_queue <<< "$run"
+    for pinned in 0 1; do
+        generate_config bench_config "$producers" "$messages" "$producer_queue" "$category_queue" "$pinned"
+
+        if ! ./ex3.out ./bench_config --bench >> "$results"; then
+            echo "Run '$run' FAILED"
+            rm -f bench_config
+            exit 1
+        fi
+        tail -n 1 "$results"
+    done
+done
+
+rm -f bench_config
@@ -3,87 +3,115 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <time.h>
 #include "BoundedBuffer.h"
-#include <string.h> // for strcmp
+#include "EditStage.h"
+#include "ReorderBuffer.h"
+#include "Bench.h"
+#include "OutputStage.h"
+#include "Overflow.h"
+#include "Dispatcher.h"
+#include "ShmBuffer.h"
+#include "Affinity.h"
+#include "Config.h"
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/wait.h>
 
-#define FINISH_MSG "DONE"
-#define MAX_MSG_LEN 256
+// How many messages each co editor thread may finish ahead of the oldest one
+#define REORDER_SLOTS_PER_THREAD 4
 
 typedef struct ForProducer {
     BoundedBuffer* buf;
     int messages;
+    int numOfCategories;
+    const CategoryInfo* categories;     // For the priority of every category
+    unsigned int seed;
 } ForProducer;
 
-typedef struct SizeAndMessages {
-    int producerId;
-    int numOfMessages;
-    int queueSize;
-} SizeAndMessages;
-
-typedef struct ConfigData {
-    int numOfProducers;
-    SizeAndMessages *producersInfo;
-    int coEditorQueueSize;
-} ConfigData;
-
-typedef struct ForDispatcher {
-    BoundedBuffer** producers;
-    BoundedBuffer* sportBuf;
-    BoundedBuffer* newsBuf;
-    BoundedBuffer* weatherBuf;
-    int producersCount;
-} ForDispatcher;
-
-typedef struct AllBufs {
-    BoundedBuffer* buf1;
-    BoundedBuffer* buf2;
-} AllBufs;
+typedef struct ForScreen {
+    BoundedBuffer* buf;
+    OutputStage* output;
+    LatencyHistogram* latencies;    // NULL unless running a benchmark
+    LatencyHistogram* laneLatencies;// One per priority lane, NULL with a single lane
+} ForScreen;
+
+typedef struct ForCoEditor {
+    BoundedBuffer* changeBuf;
+    BoundedBuffer* toScreenBuf;
+    ReorderBuffer* reorder;
+    EditStage* stage;
+    atomic_int* liveCoEditors;  // The last co editor to stop closes the screen buffer
+} ForCoEditor;
 
 /**
  * Manages the screen output by removing messages from the buffer
- * and printing them to the screen until it receives the FINISH_MSG
+ * and printing them to the screen until the co editors close it.
+ * This is the only place where a message is turned into text, the text is
+ * batched by the output stage and written once the batch is full or too old.
+ * In benchmark mode nothing is printed, only the latency of every message is recorded.
  */
 void* screenManagerFunc(void* arg) {
-    BoundedBuffer* buf = (BoundedBuffer*)arg;
-    int doneCount = 0;
+    ForScreen* forScreen = (ForScreen*)arg;
+    BoundedBuffer* buf = forScreen->buf;
+    OutputStage* output = forScreen->output;
 
     while (1) {
-        char *message;
-        message = removeFromBuffer(buf);
-
-        if (strcmp(message, FINISH_MSG) == 0) {
-            doneCount++;
-            if (doneCount == 3) break;
+        // With nothing buffered wait for the next message as long as it takes,
+        // otherwise wait only until the buffered output is due
+        long long timeLeftNs = outputTimeLeftNs(output);
+        long long timeoutUsec = timeLeftNs < 0 ? BUFFER_WAIT_FOREVER : (timeLeftNs + 999) / 1000;
+        int status;
+        Message *message = removeFromBufferTimed(buf, timeoutUsec, &status);
+        if (status == BUFFER_TIMEOUT) {
+            flushOutput(output);
+            continue;
+        }
+        if (status == BUFFER_CLOSED) break;
+
+        if (forScreen->latencies != NULL) {
+            long long latencyNs = nowNs() - message->createdNs;
+            recordLatency(forScreen->latencies, latencyNs);
+            if (forScreen->laneLatencies != NULL)
+                recordLatency(&forScreen->laneLatencies[message->priority], latencyNs);
+            free(message);
             continue;
         }
-        printf("%s\n", message);
+        outputMessage(output, message);
         free(message);
     }
     
-    printf("%s\n", FINISH_MSG);
+    if (forScreen->latencies == NULL) outputLine(output, FINISH_MSG, strlen(FINISH_MSG));
+    flushOutput(output);
     pthread_exit(EXIT_SUCCESS);
 }
 
 /**
- * Transfers messages from change buffer to the screen buffer
+ * A co editor worker, edits messages from the change buffer and passes them
+ * to the screen buffer. All the workers of a category edit in parallel and
+ * the reorder buffer keeps the category output in dispatch order.
+ * Each worker stops once the change buffer is closed and empty.
  */
 void* coEditor(void* arg) {
-    AllBufs* allBufs = (AllBufs*)arg;
-    BoundedBuffer* changeBuf = allBufs->buf1;
-    BoundedBuffer* toScreenBuf = allBufs->buf2;
-    free(allBufs);
+    ForCoEditor* forCoEditor = (ForCoEditor*)arg;
+    BoundedBuffer* changeBuf = forCoEditor->changeBuf;
+    BoundedBuffer* toScreenBuf = forCoEditor->toScreenBuf;
+    ReorderBuffer* reorder = forCoEditor->reorder;
+    EditStage* stage = forCoEditor->stage;
+    atomic_int* liveCoEditors = forCoEditor->liveCoEditors;
+    free(forCoEditor);
     
     // transfer messages from changeBuf to toScreenBuf
-    while (1) {
-        char *message;
-        message = removeFromBuffer(changeBuf);
-        usleep(100000);
-        insertToBuffer(toScreenBuf, message);
-        if (strcmp(message, FINISH_MSG) == 0) break;
+    Message *message;
+    while ((message = removeFromBuffer(changeBuf)) != NULL) {
+        stage->edit(message, stage->arg);
+        insertInOrder(reorder, message);
     }
 
+    // Everything this worker edited is already in the screen buffer
+    if (atomic_fetch_sub(liveCoEditors, 1) == 1) closeBuffer(toScreenBuf);
     pthread_exit(EXIT_SUCCESS);
 }
 
@@ -91,254 +119,286 @@ void* coEditor(void* arg) {
  * Generates messages and inserts them into the bounded buffer correctly
  */
 void* producer(void* arg) {
-    int sport = 0, news = 0, wheather = 0;
     ForProducer *forProd = (ForProducer*)arg;
     BoundedBuffer* buffer = forProd->buf;
     int mes = forProd->messages;
+    int numOfCategories = forProd->numOfCategories;
+    const CategoryInfo* categories = forProd->categories;
+    // rand() takes a global lock, every producer draws from its own seed instead
+    unsigned int seed = forProd->seed;
     free(forProd);
 
+    int *seqs = (int*) calloc(numOfCategories, sizeof(int));
+    if (seqs == NULL) {
+        printf("Failed to allocate memory for producer\n");
+        pthread_exit((void*)EXIT_FAILURE);
+    }
+
     for (int i = 0; i < mes; i++) {
-        char* message = (char*)malloc(MAX_MSG_LEN * sizeof(char));
+        int category = rand_r(&seed) % numOfCategories;
+        Message* message = createMessage(category, buffer->id, seqs[category]);
         if (message == NULL) {
             printf("Failed to allocate memory for message\n");
             pthread_exit((void*)EXIT_FAILURE);
         }
-        int r = rand() % 3;
-        switch(r) {
-            case 0:
-                snprintf(message, MAX_MSG_LEN, "producer %d SPORTS %d", buffer->id, sport);
-                sport++;
-                break;
-            case 1:
-                snprintf(message, MAX_MSG_LEN, "producer %d NEWS %d", buffer->id, news);
-                news++;
-                break;
-            case 2:
-                snprintf(message, MAX_MSG_LEN, "producer %d WEATHER %d", buffer->id, wheather);
-                wheather++;
-                break;
-            default:
-                printf("Probably aint gonna happen I hope\n");
-                break;   
-        }
+        message->priority = categories[category].priority;
+        message->createdNs = nowNs();
+        seqs[category]++;
         insertToBuffer(buffer, message);
     }
+    free(seqs);
 
-    insertToBuffer(buffer, FINISH_MSG);
+    // Let the dispatcher know there is nothing more to come
+    closeBuffer(buffer);
     pthread_exit(EXIT_SUCCESS);
 }
 
 /**
- * Moves messages from producers to the correct category buffers
-*/
-void* dispatcherFunc(void* arg) {
-    ForDispatcher* allTheBufs = (ForDispatcher*)arg;
-    BoundedBuffer** producersBufs = allTheBufs->producers;
-    BoundedBuffer* sportBuf = allTheBufs->sportBuf;
-    BoundedBuffer* newsBuf = allTheBufs->newsBuf;
-    BoundedBuffer* weatherBuf = allTheBufs->weatherBuf;
-    //int doneCount = 0;
-
-    while (1) {
-        // Assume done until we find an active one
-        int allProducersDone = 1; 
-        int didSomething = 0;
-        
-        for (int i = 0; i < allTheBufs->producersCount; i++) {
-            if (producersBufs[i]->isDone && isBufferEmpty(producersBufs[i])) continue; 
-            
-            // Found an active producer
-            allProducersDone = 0; 
-            
-            char* message = tryRemoveFromBuffer(producersBufs[i]);
-            
-            if (message != NULL) {
-                didSomething = 1;
-                if (strcmp(message, FINISH_MSG) == 0) {
-                    producersBufs[i]->isDone = 1;
-                } else {
-                    if (strstr(message, "SPORTS")) {
-                        insertToBuffer(sportBuf, message);
-                    } else if (strstr(message, "NEWS")) {
-                        insertToBuffer(newsBuf, message);
-                    } else if (strstr(message, "WEATHER")) {
-                        insertToBuffer(weatherBuf, message);
-                    }
-                }
-            }
-        }
-        
-        // Only exit if all are effectively done
-        if (allProducersDone) {
-            insertToBuffer(sportBuf, FINISH_MSG);
-            insertToBuffer(newsBuf, FINISH_MSG);
-            insertToBuffer(weatherBuf, FINISH_MSG);
-            return NULL;
-        }
-
-        // If we didn't do anything, sleep for 10ms to let producers catch up
-        if (didSomething == 0) usleep(10000); 
-    }
-}
-
-/**
- * Parses the config file and fills the ConfigData struct
+ * Generates messages like the producer thread, but in a process of its own.
+ * The messages are copied straight into the slots of a shared memory buffer.
+ * @return exit status of the process
  */
-void parseConfigFile(FILE *file, ConfigData* data) {
-    char *line = NULL;
-    ssize_t read; 
-    size_t length = 0;
-    
-    // Count producers and get co editor queue size
-    while ((read = getline(&line, &length, file)) != -1) {    
-        // Skip empty lines
-        if (read <= 1) continue;
-        
-        // Remove newline character
-        if (line[read - 1] == '\n') line[read - 1] = '\0';
-        
-        // Count number of producers
-        if (strstr(line, "PRODUCER")) data->numOfProducers++;
-        
-        // Get co editor queue size
-        if(strstr(line, "Co-Editor")) {
-            const char s[2] = " ";
-            char *token = strtok(line, s);
-            for (int i = 0; i < 4; i++) {
-                token = strtok(NULL, s);
-            }
-            data->coEditorQueueSize = atoi(token);
-        }
+int producerProcess(ShmBuffer* sb, int producerId, int messages, int numOfCategories,
+                    const CategoryInfo* categories, unsigned int seed) {
+    int *seqs = (int*) calloc(numOfCategories, sizeof(int));
+    if (seqs == NULL) {
+        printf("Failed to allocate memory for producer\n");
+        closeShmBuffer(sb);
+        return EXIT_FAILURE;
     }
 
-    // Allocate memory for producers info
-    fseek(file, 0, SEEK_SET);
-    data->producersInfo = (SizeAndMessages*) malloc(sizeof(SizeAndMessages) * data->numOfProducers);
-    if (data->producersInfo == NULL) {
-        printf("Failed to allocate memory for producers info\n");
-        fclose(file);
-        exit(EXIT_FAILURE);
-    }
-    int currentProducerIndex = 0;
-
-    // Get producers info
-    while ((read = getline(&line, &length, file)) != -1) {
-        // Skip empty lines
-        if (read <= 1) continue;
-        line[read - 1] = '\0';
-        
-        // Get producer info
-        if (strstr(line, "PRODUCER")) {
-            const char s[2] = " ";
-            char *token = strtok(line, s);
-            token = strtok(NULL, s);
-            int id = atoi(token);
-            
-            // Store ID but use sequential index
-            data->producersInfo[currentProducerIndex].producerId = id;
-
-            // if (index < 0 || index >= data->numOfProducers) {
-            //     printf("\n\n%d\n", index);
-            //     return;
-            // }
-            
-            // Read number of messages
-            read = getline(&line, &length, file);
-            line[read - 1] = '\0';
-            data->producersInfo[currentProducerIndex].numOfMessages = atoi(line);
-
-            // Read queue size
-            read = getline(&line, &length, file);
-            line[read - 1] = '\0';
-            token = strtok(line, " ");
-            token = strtok(NULL, " "); // skip "queue"
-            token = strtok(NULL, " "); // skip "size"
-            token = strtok(NULL, " "); // skip "="
-            data->producersInfo[currentProducerIndex].queueSize = atoi(token);        
-            currentProducerIndex++; // Increment specific counter
-}
+    Message message;
+    memset(&message, 0, sizeof(Message));
+    message.producerId = producerId;
+    for (int i = 0; i < messages; i++) {
+        message.category = rand_r(&seed) % numOfCategories;
+        message.seq = seqs[message.category]++;
+        message.priority = categories[message.category].priority;
+        message.createdNs = nowNs();
+        insertToShmBuffer(sb, &message, BUFFER_WAIT_FOREVER);
     }
+    free(seqs);
 
-    fclose(file);
+    closeShmBuffer(sb);
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char* argv[]) {
     // Check for config file argument
     if (argc < 2) {
         printf("Give me a file to parse\n");
+        printf("Usage: %s <config file> [--bench]\n", argv[0]);
         return 1;
     }
 
-    srand(time(NULL)); // MOVED HERE
-
-    // Open config file
-    FILE *file = fopen(argv[1], "r");
-    if (file == NULL) {
-        printf("Failed to open file: %s\n", "shit");
-        return 1;
+    // --bench prints a single JSON line with throughput, latency and queue stats
+    int benchMode = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            benchMode = 1;
+        } else {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
     }
 
-    // Parse config file
-    ConfigData *dataOfConfig = (ConfigData*) malloc(sizeof(ConfigData));
-    if (dataOfConfig == NULL) {
-        printf("Failed to allocate memory\n");
-        fclose(file);
-        return 1;
-    }
+    srand(time(NULL)); // MOVED HERE
 
-    // INitialize
-    dataOfConfig->numOfProducers = 0;
-    parseConfigFile(file, dataOfConfig);
+    // Parse config file, any problem in it ends the program with a clear message
+    ConfigData *dataOfConfig = loadConfig(argv[1]);
 
     int producersCount = dataOfConfig->numOfProducers;
+    int categoriesCount = dataOfConfig->numOfCategories;
+
+    // Register the category names for the screen manager
+    const char **names = (const char**) malloc(sizeof(char*) * categoriesCount);
+    int *threadsPerCategory = (int*) malloc(sizeof(int) * categoriesCount);
     BoundedBuffer** producersBufs = (BoundedBuffer**) malloc(sizeof(BoundedBuffer*) * producersCount);
-    if (producersBufs == NULL) {
+    BoundedBuffer** categoryBufs = (BoundedBuffer**) malloc(sizeof(BoundedBuffer*) * categoriesCount);
+    ReorderBuffer** reorderBufs = (ReorderBuffer**) malloc(sizeof(ReorderBuffer*) * categoriesCount);
+    EditStage* editStages = (EditStage*) malloc(sizeof(EditStage) * categoriesCount);
+    OverflowQueue** overflows = (OverflowQueue**) malloc(sizeof(OverflowQueue*) * categoriesCount);
+    if (names == NULL || threadsPerCategory == NULL || producersBufs == NULL || categoryBufs == NULL
+        || reorderBufs == NULL || editStages == NULL || overflows == NULL) {
         printf("Failed to allocate memory\n");
-        if (dataOfConfig->producersInfo != NULL) 
-            free(dataOfConfig->producersInfo); 
-        free(dataOfConfig);
+        free(names);
+        free(threadsPerCategory);
+        free(producersBufs);
+        free(categoryBufs);
+        free(reorderBufs);
+        free(editStages);
+        free(overflows);
+        freeConfigData(dataOfConfig);
         return 1;
     }
+    // Idle dispatchers sleep on it, created first so producer processes inherit it
+    BufferSignal* dispatchSignal = initBufferSignal();
+    if (dispatchSignal == NULL) {
+        printf("Failed to allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    // The memory of every buffer is bound to the NUMA nodes of its consumer,
+    // when that role is pinned
+    Affinity *affinity = &dataOfConfig->affinity;
+    BoundedBuffer* toScreenBuf = initBufferOnNodes(dataOfConfig->coEditorQueueSize, -1,
+                                                   affinity->nodeMask[ROLE_SCREEN]);
+    // Priority lanes only matter where categories mix: the producer buffers and
+    // the screen buffer. A category sticks to one lane, so its order is kept.
+    int numOfLanes = dataOfConfig->numOfLanes;
+    if (toScreenBuf == NULL || (numOfLanes > 1 && setBufferLanes(toScreenBuf, numOfLanes,
+                                                                 dataOfConfig->laneSchedule,
+                                                                 dataOfConfig->laneWeights) != 0)) {
+        printf("Failed to allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Every co editor of a category runs numOfWorkers threads
+    int coEditorsCount = 0;
+    for (int c = 0; c < categoriesCount; c++) {
+        CategoryInfo *info = &dataOfConfig->categoriesInfo[c];
+        if (info->numOfCoEditors < 1) info->numOfCoEditors = 1;
+        if (info->numOfWorkers < 1) info->numOfWorkers = 1;
+        int threads = info->numOfCoEditors * info->numOfWorkers;
+        names[c] = info->name;
+        threadsPerCategory[c] = threads;
+        coEditorsCount += threads;
+        categoryBufs[c] = initBufferOnNodes(info->queueSize, -1, affinity->nodeMask[ROLE_CO_EDITOR]);
+        // Let every thread finish a few messages ahead of the slowest one
+        reorderBufs[c] = initReorderBuffer(threads * REORDER_SLOTS_PER_THREAD, toScreenBuf);
+        if (categoryBufs[c] == NULL || reorderBufs[c] == NULL) {
+            printf("Failed to allocate memory\n");
+            exit(EXIT_FAILURE);
+        }
+        editStages[c].edit = simulatedEdit;
+        editStages[c].arg = &info->editCost;
+        overflows[c] = initOverflowQueue(info->overflowPolicy, info->overflowSize);
+        if (overflows[c] == NULL) {
+            printf("Failed to create the overflow queue of %s\n", info->name);
+            exit(EXIT_FAILURE);
+        }
+        // Messages put aside wait for room, the dispatchers drain them once there is
+        if (info->overflowPolicy != OVERFLOW_BLOCK)
+            setBufferSignal(categoryBufs[c], dispatchSignal, SIGNAL_ON_REMOVE);
+    }
+    setCategoryNames(names, categoriesCount);
+
+    // Producer processes hand their messages over in shared memory segments
+    ShmBuffer** shmProducers = NULL;
+    if (dataOfConfig->producerProcesses) {
+        shmProducers = (ShmBuffer**) malloc(sizeof(ShmBuffer*) * producersCount);
+        if (shmProducers == NULL) {
+            printf("Failed to allocate memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
     for (int i = 0; i < producersCount; i++) {
+        if (shmProducers != NULL) {
+            char shmName[SHM_NAME_LEN];
+            snprintf(shmName, sizeof(shmName), "/ex3-%d-%d", (int) getpid(), i);
+            shmProducers[i] = createShmBuffer(shmName, dataOfConfig->producersInfo[i].queueSize);
+            if (shmProducers[i] == NULL) {
+                printf("Failed to create shared memory buffer %s\n", shmName);
+                exit(EXIT_FAILURE);
+            }
+            shmProducers[i]->signal = dispatchSignal;
+            producersBufs[i] = NULL;
+            continue;
+        }
         producersBufs[i] = 
-        initBuffer(
+        initBufferOnNodes(
             dataOfConfig->producersInfo[i].queueSize, 
-            dataOfConfig->producersInfo[i].producerId
+            dataOfConfig->producersInfo[i].producerId,
+            affinity->nodeMask[ROLE_DISPATCHER]
         );
+        if (producersBufs[i] == NULL
+            || (numOfLanes > 1 && setBufferLanes(producersBufs[i], numOfLanes, dataOfConfig->laneSchedule,
+                                                 dataOfConfig->laneWeights) != 0)) {
+            printf("Failed to allocate memory\n");
+            exit(EXIT_FAILURE);
+        }
+        setBufferSignal(producersBufs[i], dispatchSignal, SIGNAL_ON_INSERT);
     }
-    pthread_t producers[producersCount];
-    pthread_t dispatcher;
-    BoundedBuffer* sportBuf,* newsBuf,* weatherBuf, *toScreenBuf;
-    sportBuf = initBuffer(dataOfConfig->coEditorQueueSize, -1);
-    newsBuf = initBuffer(dataOfConfig->coEditorQueueSize, -1);
-    weatherBuf = initBuffer(dataOfConfig->coEditorQueueSize, -1);
-    toScreenBuf = initBuffer(dataOfConfig->coEditorQueueSize, -1);
-
-    // Start dispatcher thread
-    ForDispatcher* forDispatcher = (ForDispatcher*) malloc(sizeof(ForDispatcher));
-    if (forDispatcher == NULL) {
+
+    // Screen output goes to stdout unless the config says otherwise
+    int ownsOutputFd = 0;
+    const char *outputTarget = dataOfConfig->outputTarget ? dataOfConfig->outputTarget : "stdout";
+    int outputFd = openOutputTarget(outputTarget, &ownsOutputFd);
+    if (outputFd < 0) {
+        printf("Failed to open screen output: %s\n", outputTarget);
+        exit(EXIT_FAILURE);
+    }
+    OutputStage* output = initOutputStage(outputFd, dataOfConfig->outputBufferSize,
+                                          dataOfConfig->outputLatencyUsec);
+    if (output == NULL) {
         printf("Failed to allocate memory\n");
-        for(int i = 0; i < producersCount; i++) 
-            destroyBuffer(producersBufs[i]);
-        free(producersBufs);
-        destroyBuffer(sportBuf);
-        destroyBuffer(newsBuf);
-        destroyBuffer(weatherBuf);
-        destroyBuffer(toScreenBuf);
-        if (dataOfConfig->producersInfo != NULL) 
-            free(dataOfConfig->producersInfo); 
-        free(dataOfConfig);
-        return 1;
+        exit(EXIT_FAILURE);
     }
-    forDispatcher->newsBuf = newsBuf;
-    forDispatcher->producers = producersBufs;
-    forDispatcher->weatherBuf = weatherBuf;
-    forDispatcher->sportBuf = sportBuf;  
-    forDispatcher->producersCount = producersCount; 
+    output->ownsFd = ownsOutputFd;
 
-    pthread_create(&dispatcher, NULL, dispatcherFunc, (void*)forDispatcher);
+    pthread_t producers[producersCount];
+    pid_t producerPids[producersCount];
+    pthread_t coEditors[coEditorsCount];
+    int dispatchersCount = dataOfConfig->numOfDispatchers < 1 ? 1 : dataOfConfig->numOfDispatchers;
+    pthread_t dispatchers[dispatchersCount];
+    ForDispatcher forDispatchers[dispatchersCount];
+    pthread_t screenManager;
+    pthread_attr_t roleAttrs[NUM_ROLES];
+    for (int r = 0; r < NUM_ROLES; r++) initRoleAttr(affinity, r, &roleAttrs[r]);
+
+    LatencyHistogram* latencies = NULL;
+    LatencyHistogram* laneLatencies = NULL;
+    if (benchMode) {
+        latencies = (LatencyHistogram*) malloc(sizeof(LatencyHistogram));
+        if (numOfLanes > 1) laneLatencies = (LatencyHistogram*) malloc(sizeof(LatencyHistogram) * numOfLanes);
+        if (latencies == NULL || (numOfLanes > 1 && laneLatencies == NULL)) {
+            printf("Failed to allocate memory\n");
+            exit(EXIT_FAILURE);
+        }
+        initHistogram(latencies);
+        for (int l = 0; laneLatencies != NULL && l < numOfLanes; l++) initHistogram(&laneLatencies[l]);
+    }
+    long long startNs = nowNs();
+
+    // Fork the producer processes before any thread exists
+    if (shmProducers != NULL) {
+        for (int i = 0; i < producersCount; i++) {
+            unsigned int seed = (unsigned int) rand();
+            producerPids[i] = fork();
+            if (producerPids[i] < 0) {
+                perror("fork");
+                exit(EXIT_FAILURE);
+            }
+            if (producerPids[i] == 0) {
+                if (affinity->isPinned[ROLE_PRODUCER])
+                    sched_setaffinity(0, sizeof(cpu_set_t), &affinity->cpus[ROLE_PRODUCER]);
+                _exit(producerProcess(shmProducers[i], dataOfConfig->producersInfo[i].producerId,
+                                      dataOfConfig->producersInfo[i].numOfMessages,
+                                      categoriesCount, dataOfConfig->categoriesInfo, seed));
+            }
+        }
+    }
 
-    for (int i = 0; i < producersCount; i++) {
+    // Start dispatcher threads, each one owns an equal shard of the producers
+    DispatchShared* dispatchShared = initDispatchShared(producersBufs, shmProducers, producersCount,
+                                                        categoryBufs, overflows,
+                                                        categoriesCount, dispatchersCount, dispatchSignal);
+    if (dispatchShared == NULL) {
+        printf("Failed to allocate memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int d = 0; d < dispatchersCount; d++) {
+        forDispatchers[d].shared = dispatchShared;
+        forDispatchers[d].shardStart = (int) ((long long) producersCount * d / dispatchersCount);
+        forDispatchers[d].shardEnd = (int) ((long long) producersCount * (d + 1) / dispatchersCount);
+        int err = pthread_create(&dispatchers[d], &roleAttrs[ROLE_DISPATCHER], dispatcherFunc,
+                                 (void*)&forDispatchers[d]);
+        if (err != 0) {
+            printf("Failed to create dispatcher thread %d: %s\n", d, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (int i = 0; shmProducers == NULL && i < producersCount; i++) {
         ForProducer *forProd = malloc(sizeof(ForProducer));
         if (forProd == NULL) {
             printf("Failed to allocate memory\n");
@@ -346,54 +406,139 @@ int main(int argc, char* argv[]) {
         }
         forProd->buf = producersBufs[i];
         forProd->messages = dataOfConfig->producersInfo[i].numOfMessages;
-        pthread_create(&producers[i], NULL, producer, (void*)forProd);
+        forProd->numOfCategories = categoriesCount;
+        forProd->categories = dataOfConfig->categoriesInfo;
+        forProd->seed = (unsigned int) rand();
+        int err = pthread_create(&producers[i], &roleAttrs[ROLE_PRODUCER], producer, (void*)forProd);
+        if (err != 0) {
+            printf("Failed to create producer thread %d of %d: %s\n", i + 1, producersCount, strerror(err));
+            exit(EXIT_FAILURE);
+        }
     }
-    pthread_t coEditors[3], screenManager;
-    AllBufs* allbufs1 = (AllBufs*) malloc(sizeof(AllBufs));
-    if (allbufs1 == NULL) {
-        printf("Failed to allocate memory\n");
-        exit(EXIT_FAILURE);
+
+    // Start co editor threads, every category gets its own group of co editors
+    atomic_int liveCoEditors;
+    atomic_init(&liveCoEditors, coEditorsCount);
+    int coEditorIndex = 0;
+    for (int c = 0; c < categoriesCount; c++) {
+        for (int e = 0; e < threadsPerCategory[c]; e++) {
+            ForCoEditor* forCoEditor = (ForCoEditor*) malloc(sizeof(ForCoEditor));
+            if (forCoEditor == NULL) {
+                printf("Failed to allocate memory\n");
+                exit(EXIT_FAILURE);
+            }
+            forCoEditor->changeBuf = categoryBufs[c];
+            forCoEditor->toScreenBuf = toScreenBuf;
+            forCoEditor->reorder = reorderBufs[c];
+            forCoEditor->stage = &editStages[c];
+            forCoEditor->liveCoEditors = &liveCoEditors;
+            int err = pthread_create(&coEditors[coEditorIndex++], &roleAttrs[ROLE_CO_EDITOR], coEditor,
+                                     (void*)forCoEditor);
+            if (err != 0) {
+                printf("Failed to create co editor thread %d of %d: %s\n", coEditorIndex, coEditorsCount,
+                       strerror(err));
+                exit(EXIT_FAILURE);
+            }
+        }
     }
-    AllBufs* allbufs2 = (AllBufs*) malloc(sizeof(AllBufs));
-    if (allbufs2 == NULL) {
-        printf("Failed to allocate memory\n");
+
+    // The screen runs until the last co editor closes its buffer
+    ForScreen forScreen;
+    forScreen.buf = toScreenBuf;
+    forScreen.output = output;
+    forScreen.latencies = latencies;
+    forScreen.laneLatencies = laneLatencies;
+    int err = pthread_create(&screenManager, &roleAttrs[ROLE_SCREEN], screenManagerFunc, (void*)&forScreen);
+    if (err != 0) {
+        printf("Failed to create screen manager thread: %s\n", strerror(err));
         exit(EXIT_FAILURE);
     }
-    AllBufs* allbufs3 = (AllBufs*) malloc(sizeof(AllBufs));
-    if (allbufs3 == NULL) {
-        printf("Failed to allocate memory\n");
-        exit(EXIT_FAILURE);
+
+    // Reap the producer processes in whatever order they end. One that died
+    // never closed its buffer, so close it here: the dispatchers drain what
+    // it left and the stream still ends
+    for (int reaped = 0; shmProducers != NULL && reaped < producersCount; ) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            break;
+        }
+        for (int i = 0; i < producersCount; i++) {
+            if (producerPids[i] != pid) continue;
+            reaped++;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                printf("Producer %d process failed\n", dataOfConfig->producersInfo[i].producerId);
+                closeShmBuffer(shmProducers[i]);
+            }
+            break;
+        }
     }
 
-    // Start co editor threads
-    allbufs1->buf1 = sportBuf;
-    allbufs1->buf2 = toScreenBuf;
-    pthread_create(&coEditors[0], NULL, coEditor, (void*)allbufs1);
-    allbufs2->buf1 = newsBuf;
-    allbufs2->buf2 = toScreenBuf;
-    pthread_create(&coEditors[1], NULL, coEditor, (void*)allbufs2);
-    allbufs3->buf1 = weatherBuf;
-    allbufs3->buf2 = toScreenBuf;
-    pthread_create(&coEditors[2], NULL, coEditor, (void*)allbufs3);
-
-    pthread_create(&screenManager, NULL, screenManagerFunc, (void*)toScreenBuf);
     pthread_join(screenManager, NULL);
+    long long elapsedNs = nowNs() - startNs;
+
+    for (int i = 0; shmProducers == NULL && i < producersCount; i++)
+        pthread_join(producers[i], NULL);
+    for (int d = 0; d < dispatchersCount; d++)
+        pthread_join(dispatchers[d], NULL);
+    for (int i = 0; i < coEditorsCount; i++)
+        pthread_join(coEditors[i], NULL);
+    for (int r = 0; r < NUM_ROLES; r++) pthread_attr_destroy(&roleAttrs[r]);
+
+    if (benchMode) {
+        BenchStage stages[] = {
+            { "producers", producersBufs, producersCount },
+            { "categories", categoryBufs, categoriesCount },
+            { "screen", &toScreenBuf, 1 },
+        };
+        // Producer processes have no BoundedBuffer to report on
+        int firstStage = shmProducers != NULL ? 1 : 0;
+        BenchReport report;
+        report.latencies = latencies;
+        report.laneLatencies = laneLatencies;
+        report.numOfLanes = numOfLanes;
+        report.elapsedNs = elapsedNs;
+        report.numOfProducers = producersCount;
+        report.numOfDispatchers = dispatchersCount;
+        report.pinnedRoles = pinnedRoles(affinity);
+        report.steals = atomic_load(&dispatchShared->steals);
+        report.stages = stages + firstStage;
+        report.numOfStages = sizeof(stages) / sizeof(stages[0]) - firstStage;
+        report.overflows = overflows;
+        report.categoryNames = names;
+        report.numOfCategories = categoriesCount;
+        printBenchReport(stdout, &report);
+        free(latencies);
+        free(laneLatencies);
+    }
 
     // memory cleanup
-    for(int i = 0; i < producersCount; i++) 
+    for(int i = 0; i < producersCount; i++) {
         destroyBuffer(producersBufs[i]);
-
+        if (shmProducers != NULL) destroyShmBuffer(shmProducers[i]);
+    }
     free(producersBufs);
+    free(shmProducers);
 
-    destroyBuffer(sportBuf);
-    destroyBuffer(newsBuf);
-    destroyBuffer(weatherBuf);
+    for (int c = 0; c < categoriesCount; c++) {
+        destroyBuffer(categoryBufs[c]);
+        destroyReorderBuffer(reorderBufs[c]);
+        destroyOverflowQueue(overflows[c]);
+    }
+    free(categoryBufs);
+    free(reorderBufs);
+    free(editStages);
+    free(overflows);
     destroyBuffer(toScreenBuf);
+    destroyOutputStage(output);
+    destroyDispatchShared(dispatchShared);
+    destroyBufferSignal(dispatchSignal);
 
-    free(forDispatcher);
-    if (dataOfConfig->producersInfo != NULL) 
-        free(dataOfConfig->producersInfo); 
-    free(dataOfConfig);
+    free(threadsPerCategory);
+    free(names);
+    freeConfigData(dataOfConfig);
 
     return 0;
-}
\ No newline at end of file
+}
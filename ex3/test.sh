@@ -10,6 +10,7 @@ declare -a configs=("config1" "config2" "config3") # Add more configuration name
 generate_config() {
     local filename=$1
     local num_producers=$2
+    local num_categories=${3:-0}
     local total_products=0
 
     for ((i=1; i<=num_producers; i++)); do
@@ -21,12 +22,36 @@ generate_config() {
         echo -e "PRODUCER $i\n$num_products\nqueue size = $queue_size\n" >> "$filename"
     done
 
+    # Optional categories, each with a random number of co-editors and workers
+    for ((c=1; c<=num_categories; c++)); do
+        local co_editors=$((RANDOM % 3 + 1))
+        local workers=$((RANDOM % 4 + 1))
+        local category_queue_size=$((RANDOM % 10 + 1))
+        # Only policies that never lose messages, the line count must stay exact
+        local policies=("block" "spill")
+        local policy=${policies[$((RANDOM % 2))]}
+        local priority=$((RANDOM % 2))
+        echo -e "CATEGORY CAT$c\nco-editors = $co_editors\nworkers = $workers\nqueue size = $category_queue_size\nedit cost = exponential 50000\noverflow policy = $policy\npriority = $priority\n" >> "$filename"
+    done
+
     # Co-Editor queue size (randomly chosen for demonstration)
     local co_editor_queue_size=$((RANDOM % 10 + 1))
 
     # Create the file and write Co-Editor queue size
     echo -e "Co-Editor queue size = $co_editor_queue_size" >> "$filename"
 
+    # Share the producers between a few dispatchers
+    echo -e "Dispatchers = $((RANDOM % 4 + 1))" >> "$filename"
+
+    # Two priority lanes, served strictly or round robin
+    local schedules=("strict" "weighted 1 4")
+    echo -e "Priority lanes = 2\nLane schedule = ${schedules[$((RANDOM % 2))]}" >> "$filename"
+
+    # Sometimes run the producers as separate processes
+    if [ $((RANDOM % 2)) -eq 0 ]; then
+        echo -e "Producer processes = yes" >> "$filename"
+    fi
+
     # Return the total number of products expected
     echo $total_products
 }
@@ -34,7 +59,8 @@ generate_config() {
 # Test each configuration
 for config in "${configs[@]}"; do
     # Generate configuration file
-    total_products=$(generate_config "$config" $((RANDOM % 5 + 1))) # Random number of producers for demonstration
+    # Random number of producers and categories (0 means the default three)
+    total_products=$(generate_config "$config" $((RANDOM % 5 + 1)) $((RANDOM % 5)))
 
     # Run the program with the configuration file with a timeout to prevent deadlock
     timeout 10s ./ex3.out "./$config" > output.txt
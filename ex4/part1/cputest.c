@@ -0,0 +1,74 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// ex4 CPU accounting test.
+// A process that spins and one that sleeps right after every short
+// burst of work run side by side for the same time. The spinner must
+// be charged for most of that time and the sleeper for a small part.
+
+#define RUN_TICKS 20
+#define QUANTUM_TIME 1000000   // time CSR units per tick, see start.c
+
+void
+spin_until(int deadline)
+{
+  while(uptime() < deadline)
+    ;
+  exit(0);
+}
+
+void
+nap_until(int deadline)
+{
+  int i;
+  volatile int x = 0;
+
+  while(uptime() < deadline){
+    for(i = 0; i < 1000; i++)
+      x++;
+    sleep(1);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int deadline = uptime() + RUN_TICKS;
+  int spinner, napper;
+  uint64 spin_time = 0, nap_time = 0, own_time = 0;
+
+  if((spinner = fork()) == 0)
+    spin_until(deadline);
+  if((napper = fork()) == 0)
+    nap_until(deadline);
+
+  // Read the times just before the children exit
+  sleep(RUN_TICKS - 2);
+  if(get_cputime(spinner, &spin_time) < 0 || get_cputime(napper, &nap_time) < 0 ||
+     get_cputime(getpid(), &own_time) < 0){
+    printf("cputest: FAIL get_cputime\n");
+    exit(1);
+  }
+  wait(0);
+  wait(0);
+
+  printf("cputest: spinner %d, sleeper %d, parent %d (1/1000 tick)\n",
+         (int)(spin_time * 1000 / QUANTUM_TIME), (int)(nap_time * 1000 / QUANTUM_TIME),
+         (int)(own_time * 1000 / QUANTUM_TIME));
+  if(get_cputime(spinner, &spin_time) == 0){
+    printf("cputest: FAIL reaped process still has a CPU time\n");
+    exit(1);
+  }
+  if(nap_time * 10 > (uint64)RUN_TICKS * QUANTUM_TIME){
+    printf("cputest: FAIL sleeper charged for more than a tenth of the run\n");
+    exit(1);
+  }
+  if(spin_time < nap_time * 5){
+    printf("cputest: FAIL spinner not charged for its run\n");
+    exit(1);
+  }
+  printf("cputest: PASS\n");
+  exit(0);
+}
@@ -0,0 +1,123 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// ex4 copy-on-write fork test and benchmark.
+// Usage: forkbench [parent heap MB] [forks]
+// First checks that a parent and a child that write the same pages
+// each see their own data, also when the kernel writes them (read
+// from a pipe). Then times forks of a parent with a large heap, with
+// children that exit right away and with children that write every
+// page, the cost copy-on-write moves from fork to the writer.
+
+#define PGSIZE 4096
+
+char *heap;
+int heap_size;
+
+void
+fill(char c)
+{
+  int i;
+
+  for(i = 0; i < heap_size; i += PGSIZE)
+    heap[i] = c;
+}
+
+int
+check(char c)
+{
+  int i;
+
+  for(i = 0; i < heap_size; i += PGSIZE)
+    if(heap[i] != c)
+      return 0;
+  return 1;
+}
+
+void
+test_isolation(void)
+{
+  int fds[2], pid, status;
+  char msg[] = "copy-on-write";
+
+  if(pipe(fds) < 0){
+    printf("forkbench: FAIL pipe\n");
+    exit(1);
+  }
+  fill('p');
+  if((pid = fork()) < 0){
+    printf("forkbench: FAIL fork\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[1]);
+    if(!check('p'))
+      exit(1);
+    // The kernel writes a page the child still shares
+    if(read(fds[0], heap + heap_size - PGSIZE, sizeof(msg)) != sizeof(msg) ||
+       strcmp(heap + heap_size - PGSIZE, msg) != 0)
+      exit(2);
+    fill('c');
+    exit(check('c') ? 0 : 3);
+  }
+  close(fds[0]);
+  write(fds[1], msg, sizeof(msg));
+  close(fds[1]);
+  wait(&status);
+  if(status != 0){
+    printf("forkbench: FAIL child saw wrong data (%d)\n", status);
+    exit(1);
+  }
+  if(!check('p')){
+    printf("forkbench: FAIL child writes reached the parent\n");
+    exit(1);
+  }
+}
+
+// Fork n children, each of which writes every page if touch is set,
+// and return the ticks it took.
+int
+time_forks(int n, int touch)
+{
+  int i, pid, start = uptime();
+
+  for(i = 0; i < n; i++){
+    if((pid = fork()) < 0){
+      printf("forkbench: FAIL fork\n");
+      exit(1);
+    }
+    if(pid == 0){
+      if(touch)
+        fill('t');
+      exit(0);
+    }
+    wait(0);
+  }
+  return uptime() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = argc > 1 ? atoi(argv[1]) : 16;
+  int forks = argc > 2 ? atoi(argv[2]) : 32;
+
+  if(argc > 3 || mb < 1 || forks < 1){
+    printf("usage: forkbench [parent heap MB] [forks]\n");
+    exit(1);
+  }
+
+  heap_size = mb * 1024 * 1024;
+  if((heap = sbrk(heap_size)) == (char *)-1){
+    printf("forkbench: FAIL sbrk\n");
+    exit(1);
+  }
+
+  test_isolation();
+
+  printf("forkbench: %d forks of a %d MB parent: %d ticks exiting, %d ticks writing every page\n",
+         forks, mb, time_forks(forks, 0), time_forks(forks, 1));
+  printf("forkbench: PASS\n");
+  exit(0);
+}
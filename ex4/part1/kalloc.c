@@ -0,0 +1,124 @@
+// Physical memory allocator, for user processes,
+// kernel stacks, page-table pages,
+// and pipe buffers. Allocates whole 4096-byte pages.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+
+void freerange(void *pa_start, void *pa_end);
+
+extern char end[]; // first address after kernel.
+                   // defined by kernel.ld.
+
+struct run {
+  struct run *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+  // ex4: how many page tables map every page, for copy-on-write
+  // fork. A page is only freed when the last one lets go of it.
+  uchar refcnt[(PHYSTOP - KERNBASE) / PGSIZE];
+} kmem;
+
+#define PA2REF(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+
+void
+kinit()
+{
+  initlock(&kmem.lock, "kmem");
+  freerange(end, (void*)PHYSTOP);
+}
+
+void
+freerange(void *pa_start, void *pa_end)
+{
+  char *p;
+  p = (char*)PGROUNDUP((uint64)pa_start);
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    kmem.refcnt[PA2REF(p)] = 1;
+    kfree(p);
+  }
+}
+
+// Drop a reference to the page of physical memory pointed at by pa,
+// and free it if that was the last one. pa normally should have
+// been returned by a call to kalloc().  (The exception is when
+// initializing the allocator; see kinit above.)
+void
+kfree(void *pa)
+{
+  struct run *r;
+
+  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+    panic("kfree");
+
+  acquire(&kmem.lock);
+  if(kmem.refcnt[PA2REF(pa)] == 0)
+    panic("kfree: free page");
+  if(--kmem.refcnt[PA2REF(pa)] > 0){
+    release(&kmem.lock);
+    return;
+  }
+  release(&kmem.lock);
+
+  // Fill with junk to catch dangling refs.
+  memset(pa, 1, PGSIZE);
+
+  r = (struct run*)pa;
+
+  acquire(&kmem.lock);
+  r->next = kmem.freelist;
+  kmem.freelist = r;
+  release(&kmem.lock);
+}
+
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.freelist;
+  if(r){
+    kmem.freelist = r->next;
+    kmem.refcnt[PA2REF(r)] = 1;
+  }
+  release(&kmem.lock);
+
+  if(r)
+    memset((char*)r, 5, PGSIZE); // fill with junk
+  return (void*)r;
+}
+
+// ex4: add a reference to the allocated page pa, which one more
+// page table now maps. At most NPROC page tables share a page.
+void
+kref(void *pa)
+{
+  acquire(&kmem.lock);
+  if(kmem.refcnt[PA2REF(pa)] == 0)
+    panic("kref");
+  kmem.refcnt[PA2REF(pa)]++;
+  release(&kmem.lock);
+}
+
+// ex4: the number of references to the allocated page pa.
+int
+krefcount(void *pa)
+{
+  int n;
+
+  acquire(&kmem.lock);
+  n = kmem.refcnt[PA2REF(pa)];
+  release(&kmem.lock);
+  return n;
+}
@@ -0,0 +1,116 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// ex4 lazy sbrk test.
+// Usage: lazytest [heap MB] [runs]
+// Checks that reserved heap pages read as zero when first touched,
+// also through system calls and after fork and shrinking, then times
+// processes that reserve a large heap but only use a little of it.
+
+#define PGSIZE 4096
+
+void
+fail(char *what)
+{
+  printf("lazytest: FAIL %s\n", what);
+  exit(1);
+}
+
+void
+test_lazy(int size)
+{
+  char *heap, *old;
+  int fds[2], pid, status, i;
+  char msg[] = "lazy";
+
+  if((heap = sbrk(size)) == (char *)-1)
+    fail("sbrk");
+
+  // Every untouched page reads as zero
+  for(i = 0; i < size; i += 64 * PGSIZE)
+    if(heap[i] != 0)
+      fail("untouched page not zero");
+  heap[size - 1] = 'x';
+  if(heap[size - 1] != 'x')
+    fail("write lost");
+
+  // The kernel writes to and reads from pages nobody touched yet
+  if(pipe(fds) < 0)
+    fail("pipe");
+  if(write(fds[1], heap + PGSIZE + 7, 1) != 1)
+    fail("write from an untouched page");
+  if(write(fds[1], msg, sizeof(msg)) != sizeof(msg))
+    fail("pipe write");
+  if(read(fds[0], heap + 2 * PGSIZE, 1 + sizeof(msg)) != 1 + sizeof(msg) ||
+     heap[2 * PGSIZE] != 0 || strcmp(heap + 2 * PGSIZE + 1, msg) != 0)
+    fail("read into an untouched page");
+  close(fds[0]);
+  close(fds[1]);
+
+  // A child gets the touched pages and its own lazy ones
+  if((pid = fork()) < 0)
+    fail("fork");
+  if(pid == 0){
+    if(heap[size - 1] != 'x' || heap[3 * PGSIZE] != 0)
+      exit(1);
+    heap[3 * PGSIZE] = 'c';
+    exit(0);
+  }
+  wait(&status);
+  if(status != 0)
+    fail("child saw wrong data");
+  if(heap[3 * PGSIZE] != 0)
+    fail("child writes reached the parent");
+
+  // Shrinking frees touched and untouched pages alike, growing
+  // again gives zero pages
+  old = sbrk(-size);
+  if(old != heap + size || sbrk(0) != heap)
+    fail("sbrk shrink");
+  if(sbrk(size) != heap)
+    fail("sbrk regrow");
+  if(heap[size - 1] != 0)
+    fail("regrown page not zero");
+  sbrk(-size);
+}
+
+// Run processes that reserve size bytes and touch a few pages, and
+// return the ticks it took.
+int
+time_reserve(int size, int runs)
+{
+  int i, pid, start = uptime();
+  char *heap;
+
+  for(i = 0; i < runs; i++){
+    if((pid = fork()) < 0)
+      fail("fork");
+    if(pid == 0){
+      if((heap = sbrk(size)) == (char *)-1)
+        exit(1);
+      heap[0] = heap[size / 2] = heap[size - 1] = 1;
+      exit(0);
+    }
+    wait(0);
+  }
+  return uptime() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = argc > 1 ? atoi(argv[1]) : 32;
+  int runs = argc > 2 ? atoi(argv[2]) : 20;
+
+  if(argc > 3 || mb < 1 || runs < 1){
+    printf("usage: lazytest [heap MB] [runs]\n");
+    exit(1);
+  }
+
+  test_lazy(mb * 1024 * 1024);
+  printf("lazytest: %d processes reserving %d MB each: %d ticks\n",
+         runs, mb, time_reserve(mb * 1024 * 1024, runs));
+  printf("lazytest: PASS\n");
+  exit(0);
+}
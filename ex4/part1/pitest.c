@@ -0,0 +1,102 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// ex4 priority inheritance test.
+// A low priority reader keeps a file's inode sleep lock held most of
+// the time by reading the whole file over and over, and CPU hogs of
+// medium priority keep every CPU busy. A high priority process reads
+// one byte of the same file now and then, and so has to wait for the
+// inode lock whenever the reader was preempted while holding it.
+// Without inheritance that wait lasts until the hogs let the reader
+// run again; with it the reader runs right away and the wait stays
+// within a few ticks.
+
+#define FILE_NAME "pitest.tmp"
+#define FILE_SIZE (20 * 1024)  // stays in the buffer cache
+#define NHOGS 6
+#define RUN_TICKS 100
+#define MAX_WAIT 5             // ticks
+
+char buf[FILE_SIZE];
+
+void
+fail(char *what)
+{
+  printf("pitest: FAIL %s\n", what);
+  exit(1);
+}
+
+void
+hog(int deadline)
+{
+  set_ps_priority(5);
+  while(uptime() < deadline)
+    ;
+  exit(0);
+}
+
+void
+reader(int deadline)
+{
+  int fd;
+
+  set_ps_priority(10);
+  while(uptime() < deadline){
+    if((fd = open(FILE_NAME, O_RDONLY)) < 0)
+      exit(1);
+    // readi() holds the inode lock for the whole read
+    read(fd, buf, FILE_SIZE);
+    close(fd);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, deadline, start, wait_ticks, max_wait = 0, reads = 0, status;
+  char c;
+
+  if((fd = open(FILE_NAME, O_CREATE | O_WRONLY)) < 0)
+    fail("create");
+  if(write(fd, buf, FILE_SIZE) != FILE_SIZE)
+    fail("write");
+  close(fd);
+
+  deadline = uptime() + RUN_TICKS;
+  for(i = 0; i < NHOGS; i++)
+    if(fork() == 0)
+      hog(deadline);
+  if(fork() == 0)
+    reader(deadline);
+
+  set_ps_priority(1);
+  while(uptime() < deadline - 10){
+    sleep(3);
+    start = uptime();
+    if((fd = open(FILE_NAME, O_RDONLY)) < 0)
+      fail("open");
+    if(read(fd, &c, 1) != 1)
+      fail("read");
+    close(fd);
+    wait_ticks = uptime() - start;
+    if(wait_ticks > max_wait)
+      max_wait = wait_ticks;
+    reads++;
+  }
+
+  for(i = 0; i < NHOGS + 1; i++){
+    wait(&status);
+    if(status != 0)
+      fail("child");
+  }
+  unlink(FILE_NAME);
+
+  printf("pitest: %d reads, longest %d ticks\n", reads, max_wait);
+  if(max_wait > MAX_WAIT)
+    fail("high priority reader waited too long");
+  printf("pitest: PASS\n");
+  exit(0);
+}
@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -20,6 +21,20 @@ static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// ex4 wait queues: a sleeping process is linked into the wait queue
+// its channel hashes to, so wakeup(chan) only looks at the processes
+// that may be sleeping on chan instead of every proc[] slot.
+// Lock order: the condition lock given to sleep(), then a wait
+// queue lock, then p->lock.
+#define NWAITQ 64
+
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;           // sleepers, linked through p->wq_next
+};
+
+struct waitq waitqs[NWAITQ];
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
@@ -51,6 +66,9 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  schedinit();
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitqs[i].lock, "waitq");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -102,30 +120,13 @@ allocpid()
   return pid;
 }
 
-// ex4 helper function to find minimum accumulator
-long long
-get_min_accumulator(struct proc *except_p)
+// Mark p RUNNABLE and queue it on the run queue of the CPU
+// it last ran on. Caller must hold p->lock.
+static void
+make_runnable(struct proc *p)
 {
-  struct proc *p;
-  long long min_acc = -1;
-
-  for(p = proc; p < &proc[NPROC]; p++) {
-    // Skip the process we are currently modifying
-    if(p == except_p) 
-      continue;
-
-    acquire(&p->lock);
-    if(p->state == RUNNABLE || p->state == RUNNING) {
-      if(min_acc == -1 || p->accumulator < min_acc) {
-        min_acc = p->accumulator;
-      }
-    }
-    release(&p->lock);
-  }
-
-  // If no other processes are running, return 0
-  if(min_acc == -1) return 0;
-  return min_acc;
+  p->state = RUNNABLE;
+  sched_enqueue(p);
 }
 
 // Look in the process table for an UNUSED proc.
@@ -150,10 +151,17 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->state = USED;
+  p->cpu = cpuid();         // p->lock is held, so interrupts are off
 
   p->ps_priority = 5;       // Default priority
-  // Set accumulator to system minimum to prevent starvation of others
-  p->accumulator = get_min_accumulator(p);
+  p->boost_priority = 0;
+  p->boost_credit = 0;
+  p->held = 0;
+  p->cputime = 0;
+  p->acc_frac = 0;
+  sched_stats_reset(p);
+  // The policy gives it a starting key when it is first queued
+  sched_place(p, 0);
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -279,7 +287,7 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  make_runnable(p);
 
   release(&p->lock);
 }
@@ -349,7 +357,7 @@ fork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  make_runnable(np);
   release(&np->lock);
 
   return pid;
@@ -467,53 +475,40 @@ wait(uint64 addr)
 void
 scheduler(void)
 {
-  struct proc *p;
   struct cpu *c = mycpu();
-  struct proc *min_p; // for tracking the best candidate
+  struct proc *min_p; // the RUNNABLE process the policy picked
 
   c->proc = 0;
   for(;;){
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    min_p = 0;
-
-    // Iterate through all processes to find the RUNNABLE candidate with lowest accumulator
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-
-      if(p->state == RUNNABLE) {
-        // If we haven't found a candidate yet, take this one
-        if(min_p == 0) {
-          min_p = p;
-          continue; // keep the lock on min_p and continue scanning
-        }
-        else {
-          // Compare accumulators
-          // '<' ensures tie-breaking: prefer lower index (found earlier)
-          if(p->accumulator < min_p->accumulator) {
-             release(&min_p->lock); // Release the old best
-             min_p = p;             // This is the new best
-             continue;              // Keep lock on new min_p
-          }
-        }
-      }
-      
-      // If p was not runnable OR not better than min_p, release lock immediately
-      release(&p->lock);
+    min_p = sched_pick_next(c - cpus);
+    if(min_p == 0){
+      sched_idle(c);
+      continue;
     }
 
-    // If we found a matching candidate - run it
-    if(min_p != 0) {
-      // min_p is already locked from the loop above
+    // A process is only queued once it is off its CPU, so
+    // nobody else is switching away from min_p.
+    acquire(&min_p->lock);
+    if(min_p->state == RUNNABLE) {
       min_p->state = RUNNING;
+      min_p->cpu = c - cpus;
       c->proc = min_p;
+      sched_run_start(c, min_p);
       swtch(&c->context, &min_p->context);
 
       // Process is done running for now.
+      // Charge it before a yield() queues it: its key must not
+      // change while it is in a run queue. c->proc is still set,
+      // so sched_enqueue() knows this CPU is about to pick again.
+      sched_run_end(c, min_p);
+      if(min_p->state == RUNNABLE)
+        sched_enqueue(min_p);
       c->proc = 0;
-      release(&min_p->lock);
     }
+    release(&min_p->lock);
   }
 }
 
@@ -545,6 +540,7 @@ sched(void)
 }
 
 // Give up the CPU for one scheduling round.
+// scheduler() queues p again once it has charged it.
 void
 yield(void)
 {
@@ -570,55 +566,128 @@ forkret(void)
   usertrapret();
 }
 
+// The wait queue of chan. Channels are addresses of kernel objects,
+// so the low bits carry little information.
+static struct waitq*
+waitq_for(void *chan)
+{
+  uint64 h = (uint64)chan;
+
+  h ^= h >> 16;
+  return &waitqs[(h >> 3) % NWAITQ];
+}
+
+// Unlink p from wq. Caller must hold wq->lock.
+static void
+waitq_remove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &wq->head; *pp != 0; pp = &(*pp)->wq_next){
+    if(*pp == p){
+      *pp = p->wq_next;
+      break;
+    }
+  }
+  p->wq_next = 0;
+  p->wq = 0;
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = waitq_for(chan);
+  int linked;
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
-  // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // Once we hold the wait queue lock and p->lock,
+  // we can be guaranteed that we won't miss any
+  // wakeup (wakeup locks both),
   // so it's okay to release lk.
 
+  acquire(&wq->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->wq = wq;
+  p->wq_next = wq->head;
+  wq->head = p;
+  release(&wq->lock);
 
   sched();
 
-  // Tidy up.
+  // Tidy up. wakeup() unlinks the processes it wakes,
+  // kill() does not.
   p->chan = 0;
+  linked = p->wq != 0;
 
   // Reacquire original lock.
   release(&p->lock);
+  if(linked){
+    acquire(&wq->lock);
+    if(p->wq == wq)
+      waitq_remove(wq, p);
+    release(&wq->lock);
+  }
   acquire(lk);
 }
 
 void
 wakeup(void *chan)
 {
+  struct waitq *wq = waitq_for(chan);
+  struct proc *p, **pp;
+
+  acquire(&wq->lock);
+  pp = &wq->head;
+  while((p = *pp) != 0) {
+    // Other channels can share the queue. p->chan only changes
+    // under the wait queue lock while p is linked, except for
+    // a killed process clearing it, which is checked below.
+    if(p->chan != chan){
+      pp = &p->wq_next;
+      continue;
+    }
+    acquire(&p->lock);
+    *pp = p->wq_next;
+    p->wq_next = 0;
+    p->wq = 0;
+    if(p->state == SLEEPING && p->chan == chan) {
+      // Let the policy decide how much credit the sleep is worth
+      sched_place(p, 1);
+      make_runnable(p);
+    }
+    release(&p->lock);
+  }
+  release(&wq->lock);
+}
+
+// ex4: the highest priority (lowest sched_priority()) among the
+// processes sleeping on chan, or 0 if there are none.
+int
+sleepers_priority(void *chan)
+{
+  struct waitq *wq = waitq_for(chan);
   struct proc *p;
+  int prio = 0;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        // --- ASSIGNMENT LOGIC ---
-        // Reset accumulator to prevent gaining advantage after sleep
-        p->accumulator = get_min_accumulator(p);
-        // ------------------------
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
+  acquire(&wq->lock);
+  for(p = wq->head; p != 0; p = p->wq_next){
+    acquire(&p->lock);
+    if(p->state == SLEEPING && p->chan == chan &&
+       (prio == 0 || sched_priority(p) < prio))
+      prio = sched_priority(p);
+    release(&p->lock);
   }
+  release(&wq->lock);
+  return prio;
 }
 
 // Kill the process with the given pid.
@@ -635,7 +704,7 @@ kill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        make_runnable(p);
       }
       release(&p->lock);
       return 0;
@@ -645,6 +714,56 @@ kill(int pid)
   return -1;
 }
 
+// ex4: copy the CPU time the process with the given pid has
+// used so far, in time CSR units, to *time.
+// Returns 0, or -1 if there is no such process.
+int
+get_cputime(int pid, uint64 *time)
+{
+  struct proc *p;
+
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      *time = p->cputime;
+      // Add the part of the current run that isn't charged yet
+      if(p->state == RUNNING)
+        *time += r_time() - p->run_start;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// ex4: copy the scheduling statistics of the process with the given
+// pid, or of the whole system if pid is 0, to *st.
+// Returns 0, or -1 if there is no such process.
+int
+get_sched_stats(int pid, struct sched_stats *st)
+{
+  struct proc *p;
+
+  if(pid == 0){
+    sched_stats_get(0, st);
+    return 0;
+  }
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      sched_stats_get(p, st);
+      // Add the part of the current run that isn't charged yet
+      if(p->state == RUNNING)
+        st->runtime += r_time() - p->run_start;
+      release(&p->lock);
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
 void
 setkilled(struct proc *p)
 {
@@ -24,6 +24,8 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  long long running_key;      // scheduling key of proc, see sched.c
+  int idle;                   // waiting in sched_idle() for work
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +83,24 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A kernel timer. While armed it sits in the timer wheel in trap.c,
+// which wakes up chan once ticks reaches deadline.
+// tickslock must be held when using it.
+struct timer {
+  uint deadline;               // Tick to fire at
+  void *chan;                  // Channel to wake up
+  struct timer *next;
+  struct timer **pprev;        // 0 while not armed
+};
+
+// Node of a run queue's red-black tree, see sched.c.
+struct rb_node {
+  struct rb_node *parent;
+  struct rb_node *left;
+  struct rb_node *right;
+  int red;
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -105,6 +125,31 @@ struct proc {
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 
+  // the wait queue lock must be held when using these:
+  struct waitq *wq;            // Wait queue p is linked into, if any
+  struct proc *wq_next;        // Next sleeper in the same wait queue
+
+  struct timer timer;          // Deadline of sleep(), tickslock must be held
+
   long long accumulator;       // Total cost of CPU time used
   int ps_priority;             // Priority (1-10)
+  uint64 run_start;            // time CSR when p was last switched in
+  uint64 cputime;              // time CSR units p has run for
+  uint64 acc_frac;             // Charge below one accumulator unit, times QUANTUM_TIME
+  int cpu;                     // CPU whose run queue p goes back to (p->lock)
+
+  // the policy in sched.c uses these, under p->lock or run queue lock:
+  struct proc *rq_next;        // Next in a round robin queue
+  int rq_index;                // Slot in an accumulator heap
+  struct rb_node rb;           // Node in a cfs tree
+  long long vruntime;          // Weighted CPU time, cfs key
+  int rr_seq;                  // Enqueue order, round robin key
+  int sched_gen;               // Policy generation p's key belongs to
+  int sched_place;             // How p comes back to a run queue
+  int on_rq;                   // In a run queue (run queue lock)
+  int boost_priority;          // Inherited priority, 0 if none (p->lock)
+  long long boost_credit;      // Key lent by sched_boost(), to charge back
+  int boost_gen;               // Policy generation boost_credit belongs to
+
+  struct sleeplock *held;      // Sleep locks p holds, only used by p
 };
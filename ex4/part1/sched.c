@@ -0,0 +1,925 @@
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sched.h"
+#include "defs.h"
+
+// ex4 run queues: every CPU has a queue of RUNNABLE processes, and
+// the policy in use decides how it is ordered and what running costs.
+// A process is in exactly one queue while it is RUNNABLE.
+// Lock order: p->lock before a run queue lock. Only
+// sched_set_policy() holds more than one run queue lock, and it
+// takes them in array order.
+struct runq {
+  struct spinlock lock;
+  int n;                       // queued processes
+  long long min_key;           // key of the next process, valid when n > 0
+
+  struct proc *head, *tail;    // round robin: FIFO through p->rq_next
+  struct proc *heap[NPROC];    // accumulator: min-heap, p->rq_index
+  struct rb_node *root;        // cfs: red-black tree by vruntime
+  struct rb_node *leftmost;    // cfs: the next process
+};
+
+// A scheduling policy. The queue hooks are called with rq->lock
+// held and rq->n already counting the change. place and tick change
+// the key, so they only see a process that is in no queue, with
+// p->lock held: place right before it is queued, tick after it ran
+// and before scheduler() queues it again. A queued process's key
+// only changes when it is taken off under rq->lock first, as in
+// sched_boost(), sched_unboost() and sched_set_policy().
+struct sched_ops {
+  char *name;
+  void (*enqueue)(struct runq *rq, struct proc *p);
+  void (*dequeue)(struct runq *rq, struct proc *p);
+  struct proc* (*pick_next)(struct runq *rq);  // next to run, still queued
+  long long (*key)(struct proc *p);            // lower runs first
+  void (*place)(struct proc *p, int how);      // starting key, PLACE_*
+  void (*tick)(struct proc *p, uint64 ran);    // charge ran time CSR units
+  void (*boost)(struct proc *p, long long key); // set p's key to key, or 0
+  long long slack;             // key distance that moves a process between CPUs
+};
+
+// How a process comes back to a run queue, see p->sched_place.
+#define PLACE_NONE 0           // from yield() or kill()
+#define PLACE_NEW  1           // created, or queued under a new policy
+#define PLACE_WAKE 2           // woken up
+
+// Length of a scheduling quantum in time CSR units, the timer
+// interval set up in start.c.
+#define QUANTUM_TIME 1000000
+
+struct runq runqs[NCPU];
+
+extern struct proc proc[NPROC];
+
+// ex4 scheduling statistics of every proc[] slot, under its p->lock,
+// and of the whole system, updated with atomic adds.
+static struct sched_stats stats[NPROC];
+static uint64 runnable_since[NPROC];  // time CSR when the slot was queued
+static struct sched_stats total;
+
+static struct sched_ops *policy;   // changed with every run queue lock held
+static int policy_id;
+static int policy_gen;             // bumped on every policy change
+
+// Lowest key among the queued processes and the running ones other
+// than except_p, 0 if there are none. Reads 2 * NCPU values without
+// locks, so the result can be slightly stale, which is fine for a
+// starting key.
+static long long
+min_key(struct proc *except_p)
+{
+  long long min = 0;
+  int found = 0;
+  int i;
+
+  for(i = 0; i < NCPU; i++) {
+    if(runqs[i].n > 0 && (!found || runqs[i].min_key < min)){
+      min = runqs[i].min_key;
+      found = 1;
+    }
+    if(cpus[i].proc != 0 && cpus[i].proc != except_p &&
+       (!found || cpus[i].running_key < min)){
+      min = cpus[i].running_key;
+      found = 1;
+    }
+  }
+  return min;
+}
+
+//
+// Round robin: first in, first out, running costs nothing.
+// The key is a global enqueue sequence number, so balancing
+// moves the process that has waited longest.
+//
+
+static int rr_seq;
+
+static void
+rr_enqueue(struct runq *rq, struct proc *p)
+{
+  p->rr_seq = __sync_fetch_and_add(&rr_seq, 1);
+  p->rq_next = 0;
+  if(rq->tail)
+    rq->tail->rq_next = p;
+  else
+    rq->head = p;
+  rq->tail = p;
+}
+
+static void
+rr_dequeue(struct runq *rq, struct proc *p)
+{
+  struct proc **pp, *prev = 0;
+
+  for(pp = &rq->head; *pp != 0; prev = *pp, pp = &(*pp)->rq_next){
+    if(*pp == p){
+      *pp = p->rq_next;
+      if(rq->tail == p)
+        rq->tail = prev;
+      break;
+    }
+  }
+  p->rq_next = 0;
+}
+
+static struct proc*
+rr_pick_next(struct runq *rq)
+{
+  return rq->head;
+}
+
+static long long
+rr_key(struct proc *p)
+{
+  return p->rr_seq;
+}
+
+static void
+rr_place(struct proc *p, int how)
+{
+}
+
+static void
+rr_tick(struct proc *p, uint64 ran)
+{
+}
+
+//
+// Accumulator: the lowest accumulator runs first, running a whole
+// quantum costs ps_priority and running part of it costs that part.
+// New and woken processes start at the lowest accumulator around.
+//
+
+// Heap order: lower accumulator first, ties go to the lower
+// proc[] slot like the old table scan did.
+static int
+acc_less(struct proc *a, struct proc *b)
+{
+  if(a->accumulator != b->accumulator)
+    return a->accumulator < b->accumulator;
+  return a < b;
+}
+
+static void
+acc_set(struct runq *rq, int i, struct proc *p)
+{
+  rq->heap[i] = p;
+  p->rq_index = i;
+}
+
+// Move p, which belongs at slot i, up or down to its place.
+static void
+acc_sift(struct runq *rq, int i, struct proc *p)
+{
+  int child;
+
+  while(i > 0 && acc_less(p, rq->heap[(i - 1) / 2])){
+    acc_set(rq, i, rq->heap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  while((child = 2 * i + 1) < rq->n){
+    if(child + 1 < rq->n && acc_less(rq->heap[child + 1], rq->heap[child]))
+      child++;
+    if(!acc_less(rq->heap[child], p))
+      break;
+    acc_set(rq, i, rq->heap[child]);
+    i = child;
+  }
+  acc_set(rq, i, p);
+}
+
+static void
+acc_enqueue(struct runq *rq, struct proc *p)
+{
+  acc_sift(rq, rq->n - 1, p);
+}
+
+static void
+acc_dequeue(struct runq *rq, struct proc *p)
+{
+  struct proc *last = rq->heap[rq->n];
+
+  if(last != p)
+    acc_sift(rq, p->rq_index, last);
+  p->rq_index = -1;
+}
+
+static struct proc*
+acc_pick_next(struct runq *rq)
+{
+  return rq->n > 0 ? rq->heap[0] : 0;
+}
+
+static long long
+acc_key(struct proc *p)
+{
+  return p->accumulator;
+}
+
+static void
+acc_place(struct proc *p, int how)
+{
+  // Reset accumulator to prevent gaining advantage after sleep
+  p->accumulator = min_key(p);
+  p->acc_frac = 0;
+}
+
+static void
+acc_tick(struct proc *p, uint64 ran)
+{
+  p->acc_frac += ran * sched_priority(p);
+  p->accumulator += p->acc_frac / QUANTUM_TIME;
+  p->acc_frac %= QUANTUM_TIME;
+}
+
+static void
+acc_boost(struct proc *p, long long key)
+{
+  p->accumulator = key;
+}
+
+//
+// CFS-like: the lowest virtual runtime runs first. Virtual time
+// passes slower for higher priorities: every ps_priority step is
+// worth about 25% of CPU share, as with nice levels. A woken process
+// keeps up to half a quantum of credit for the time it slept.
+//
+
+#define CFS_NICE0_WEIGHT 1024
+#define CFS_SLEEPER_CREDIT (QUANTUM_TIME / 2)
+
+// Weight of every ps_priority, 5 is the default.
+static const int cfs_weight[11] = {
+  0, 2501, 1991, 1586, 1277, 1024, 820, 655, 526, 423, 335
+};
+
+#define rb_proc(n) ((struct proc *)((char *)(n) - __builtin_offsetof(struct proc, rb)))
+
+static int
+cfs_less(struct proc *a, struct proc *b)
+{
+  if(a->vruntime != b->vruntime)
+    return a->vruntime < b->vruntime;
+  return a < b;
+}
+
+// Make the right child of x take its place.
+static void
+rb_rotate_left(struct runq *rq, struct rb_node *x)
+{
+  struct rb_node *y = x->right;
+
+  x->right = y->left;
+  if(y->left)
+    y->left->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    rq->root = y;
+  else if(x == x->parent->left)
+    x->parent->left = y;
+  else
+    x->parent->right = y;
+  y->left = x;
+  x->parent = y;
+}
+
+// Make the left child of x take its place.
+static void
+rb_rotate_right(struct runq *rq, struct rb_node *x)
+{
+  struct rb_node *y = x->left;
+
+  x->left = y->right;
+  if(y->right)
+    y->right->parent = x;
+  y->parent = x->parent;
+  if(x->parent == 0)
+    rq->root = y;
+  else if(x == x->parent->right)
+    x->parent->right = y;
+  else
+    x->parent->left = y;
+  y->right = x;
+  x->parent = y;
+}
+
+static void
+rb_insert_fixup(struct runq *rq, struct rb_node *z)
+{
+  struct rb_node *uncle;
+
+  while(z->parent && z->parent->red){
+    struct rb_node *gp = z->parent->parent;
+    if(z->parent == gp->left){
+      uncle = gp->right;
+      if(uncle && uncle->red){
+        z->parent->red = 0;
+        uncle->red = 0;
+        gp->red = 1;
+        z = gp;
+      } else {
+        if(z == z->parent->right){
+          z = z->parent;
+          rb_rotate_left(rq, z);
+        }
+        z->parent->red = 0;
+        gp->red = 1;
+        rb_rotate_right(rq, gp);
+      }
+    } else {
+      uncle = gp->left;
+      if(uncle && uncle->red){
+        z->parent->red = 0;
+        uncle->red = 0;
+        gp->red = 1;
+        z = gp;
+      } else {
+        if(z == z->parent->left){
+          z = z->parent;
+          rb_rotate_right(rq, z);
+        }
+        z->parent->red = 0;
+        gp->red = 1;
+        rb_rotate_left(rq, gp);
+      }
+    }
+  }
+  rq->root->red = 0;
+}
+
+// Put v where u is, as a child of u's parent.
+static void
+rb_transplant(struct runq *rq, struct rb_node *u, struct rb_node *v)
+{
+  if(u->parent == 0)
+    rq->root = v;
+  else if(u == u->parent->left)
+    u->parent->left = v;
+  else
+    u->parent->right = v;
+  if(v)
+    v->parent = u->parent;
+}
+
+// Restore the colors after removing a black node. x took its place
+// and may be null, so its parent is passed along.
+static void
+rb_erase_fixup(struct runq *rq, struct rb_node *x, struct rb_node *parent)
+{
+  struct rb_node *w;
+
+  while(x != rq->root && (x == 0 || !x->red)){
+    if(x == parent->left){
+      w = parent->right;
+      if(w->red){
+        w->red = 0;
+        parent->red = 1;
+        rb_rotate_left(rq, parent);
+        w = parent->right;
+      }
+      if((w->left == 0 || !w->left->red) && (w->right == 0 || !w->right->red)){
+        w->red = 1;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if(w->right == 0 || !w->right->red){
+          w->left->red = 0;
+          w->red = 1;
+          rb_rotate_right(rq, w);
+          w = parent->right;
+        }
+        w->red = parent->red;
+        parent->red = 0;
+        if(w->right)
+          w->right->red = 0;
+        rb_rotate_left(rq, parent);
+        x = rq->root;
+      }
+    } else {
+      w = parent->left;
+      if(w->red){
+        w->red = 0;
+        parent->red = 1;
+        rb_rotate_right(rq, parent);
+        w = parent->left;
+      }
+      if((w->right == 0 || !w->right->red) && (w->left == 0 || !w->left->red)){
+        w->red = 1;
+        x = parent;
+        parent = x->parent;
+      } else {
+        if(w->left == 0 || !w->left->red){
+          w->right->red = 0;
+          w->red = 1;
+          rb_rotate_left(rq, w);
+          w = parent->left;
+        }
+        w->red = parent->red;
+        parent->red = 0;
+        if(w->left)
+          w->left->red = 0;
+        rb_rotate_right(rq, parent);
+        x = rq->root;
+      }
+    }
+  }
+  if(x)
+    x->red = 0;
+}
+
+static void
+cfs_enqueue(struct runq *rq, struct proc *p)
+{
+  struct rb_node *z = &p->rb, *parent = 0, **link = &rq->root;
+  int leftmost = 1;
+
+  while(*link){
+    parent = *link;
+    if(cfs_less(p, rb_proc(parent))){
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      leftmost = 0;
+    }
+  }
+  z->parent = parent;
+  z->left = z->right = 0;
+  z->red = 1;
+  *link = z;
+  if(leftmost)
+    rq->leftmost = z;
+  rb_insert_fixup(rq, z);
+}
+
+static void
+cfs_dequeue(struct runq *rq, struct proc *p)
+{
+  struct rb_node *z = &p->rb, *x, *parent, *y;
+  int removed_red = z->red;
+
+  if(rq->leftmost == z){
+    // the next one is the leftmost node of the right subtree, or the parent
+    if(z->right){
+      for(y = z->right; y->left; y = y->left)
+        ;
+      rq->leftmost = y;
+    } else {
+      rq->leftmost = z->parent;
+    }
+  }
+
+  if(z->left == 0){
+    x = z->right;
+    parent = z->parent;
+    rb_transplant(rq, z, z->right);
+  } else if(z->right == 0){
+    x = z->left;
+    parent = z->parent;
+    rb_transplant(rq, z, z->left);
+  } else {
+    for(y = z->right; y->left; y = y->left)
+      ;
+    removed_red = y->red;
+    x = y->right;
+    if(y->parent == z){
+      parent = y;
+    } else {
+      parent = y->parent;
+      rb_transplant(rq, y, y->right);
+      y->right = z->right;
+      y->right->parent = y;
+    }
+    rb_transplant(rq, z, y);
+    y->left = z->left;
+    y->left->parent = y;
+    y->red = z->red;
+  }
+  if(!removed_red && rq->root)
+    rb_erase_fixup(rq, x, parent);
+  z->parent = z->left = z->right = 0;
+}
+
+static struct proc*
+cfs_pick_next(struct runq *rq)
+{
+  return rq->leftmost ? rb_proc(rq->leftmost) : 0;
+}
+
+static long long
+cfs_key(struct proc *p)
+{
+  return p->vruntime;
+}
+
+static void
+cfs_place(struct proc *p, int how)
+{
+  long long min = min_key(p);
+
+  if(how == PLACE_NEW)
+    p->vruntime = min;
+  else if(p->vruntime < min - CFS_SLEEPER_CREDIT)
+    p->vruntime = min - CFS_SLEEPER_CREDIT;
+}
+
+static void
+cfs_tick(struct proc *p, uint64 ran)
+{
+  p->vruntime += ran * CFS_NICE0_WEIGHT / cfs_weight[sched_priority(p)];
+}
+
+static void
+cfs_boost(struct proc *p, long long key)
+{
+  p->vruntime = key;
+}
+
+static struct sched_ops policies[NSCHED] = {
+  [SCHED_RR] = {
+    "rr", rr_enqueue, rr_dequeue, rr_pick_next, rr_key, rr_place, rr_tick, 0, 2 * NCPU
+  },
+  [SCHED_ACCUMULATOR] = {
+    // about two quanta at the default priority
+    "accumulator", acc_enqueue, acc_dequeue, acc_pick_next, acc_key, acc_place, acc_tick, acc_boost, 10
+  },
+  [SCHED_CFS] = {
+    "cfs", cfs_enqueue, cfs_dequeue, cfs_pick_next, cfs_key, cfs_place, cfs_tick, cfs_boost, 2 * QUANTUM_TIME
+  },
+};
+
+void
+schedinit(void)
+{
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runqs[i].lock, "runq");
+  policy_id = SCHED_ACCUMULATOR;
+  policy = &policies[policy_id];
+}
+
+// Caller must hold rq->lock.
+static void
+runq_update_min(struct runq *rq)
+{
+  if(rq->n > 0)
+    rq->min_key = policy->key(policy->pick_next(rq));
+}
+
+// Wake CPU id from the wfi in sched_idle() with a machine software
+// interrupt, which timervec in kernelvec.S acknowledges.
+static void
+kick_cpu(int id)
+{
+  *(volatile uint32 *)CLINT_MSIP(id) = 1;
+}
+
+// Work was just queued for CPU target. Kick it if it is idle, or
+// else some other idle CPU, which will pull the work over.
+// Interrupts must be off.
+static void
+kick_idle(int target)
+{
+  int self = cpuid();
+  int i;
+
+  // pairs with the one in sched_idle(): either that CPU sees the
+  // queued process, or this one sees it idle.
+  __sync_synchronize();
+  if(cpus[target].idle){
+    kick_cpu(target);
+    return;
+  }
+  for(i = 0; i < NCPU; i++){
+    if(i != self && cpus[i].idle){
+      kick_cpu(i);
+      return;
+    }
+  }
+}
+
+// CPU c found nothing to run. Wait for an interrupt or a kick in wfi
+// instead of spinning on the run queues. Interrupts stay off from the
+// check to the wfi, so none can queue work in between unseen; wfi
+// still ends on a pending one, which is taken once they are back on.
+void
+sched_idle(struct cpu *c)
+{
+  struct runq *rq;
+
+  intr_off();
+  c->idle = 1;
+  __sync_synchronize();
+  for(rq = runqs; rq < &runqs[NCPU]; rq++)
+    if(rq->n > 0)
+      break;
+  if(rq == &runqs[NCPU])
+    asm volatile("wfi");
+  c->idle = 0;
+  intr_on();
+}
+
+// Queue p on the run queue of the CPU it last ran on.
+// Caller must hold p->lock and have made p RUNNABLE.
+void
+sched_enqueue(struct proc *p)
+{
+  struct runq *rq = &runqs[p->cpu];
+  int how = p->sched_place;
+
+  if(p->on_rq)
+    panic("sched_enqueue: queued");
+  runnable_since[p - proc] = r_time();
+  acquire(&rq->lock);
+  // A key from an earlier policy means nothing to this one
+  if(p->sched_gen != policy_gen)
+    how = PLACE_NEW;
+  // A fresh key owes nothing for a boost
+  if(how != PLACE_NONE){
+    policy->place(p, how);
+    p->boost_credit = 0;
+  }
+  p->sched_gen = policy_gen;
+  p->sched_place = PLACE_NONE;
+  rq->n++;
+  policy->enqueue(rq, p);
+  p->on_rq = 1;
+  runq_update_min(rq);
+  release(&rq->lock);
+
+  // A process that yields is picked up again by its own CPU.
+  // Anything else may be new work for an idle CPU.
+  if(p != myproc())
+    kick_idle(p->cpu);
+}
+
+// Tell the next sched_enqueue() of p that it was just created
+// (woken == 0) or woken up.
+// Caller must hold p->lock.
+void
+sched_place(struct proc *p, int woken)
+{
+  p->sched_place = woken ? PLACE_WAKE : PLACE_NEW;
+}
+
+// Remove and return the next process of rq, or 0 if it is empty.
+static struct proc*
+runq_take(struct runq *rq)
+{
+  struct proc *p;
+
+  acquire(&rq->lock);
+  p = policy->pick_next(rq);
+  if(p){
+    rq->n--;
+    policy->dequeue(rq, p);
+    p->on_rq = 0;
+    runq_update_min(rq);
+  }
+  release(&rq->lock);
+  return p;
+}
+
+// Pick the next process for CPU id. Usually that is the next one of
+// the CPU's own queue. An idle CPU pulls from the longest queue, and
+// a busy one pulls from the queue whose next process is more than
+// the policy's slack ahead of its own, so no queue falls far behind.
+// The other queues are only read without their locks to choose a victim.
+struct proc*
+sched_pick_next(int id)
+{
+  struct runq *own = &runqs[id];
+  struct runq *rq, *victim = 0;
+  struct proc *p = 0;
+  long long slack = policy->slack;
+
+  for(rq = runqs; rq < &runqs[NCPU]; rq++){
+    if(rq == own || rq->n == 0)
+      continue;
+    if(own->n == 0){
+      if(victim == 0 || rq->n > victim->n)
+        victim = rq;
+    } else if(rq->min_key + slack < own->min_key){
+      if(victim == 0 || rq->min_key < victim->min_key)
+        victim = rq;
+    }
+  }
+
+  if(victim != 0)
+    p = runq_take(victim);
+  if(p == 0)
+    p = runq_take(own);
+  return p;
+}
+
+// p is about to run on c. Caller must hold p->lock.
+void
+sched_run_start(struct cpu *c, struct proc *p)
+{
+  struct sched_stats *st = &stats[p - proc];
+  uint64 wait;
+  int b;
+
+  c->running_key = policy->key(p);
+  p->run_start = r_time();
+
+  wait = p->run_start - runnable_since[p - proc];
+  for(b = 0; b < NSCHEDHIST - 1 && wait >= ((uint64)SCHEDHIST_MIN << b); b++)
+    ;
+  st->waittime += wait;
+  st->nswitch++;
+  st->latency[b]++;
+  __sync_fetch_and_add(&total.waittime, wait);
+  __sync_fetch_and_add(&total.nswitch, 1);
+  __sync_fetch_and_add(&total.latency[b], 1);
+}
+
+// p is back from running. Charge it for the time it really ran.
+// Caller must hold p->lock.
+void
+sched_run_end(struct cpu *c, struct proc *p)
+{
+  struct sched_stats *st = &stats[p - proc];
+  uint64 ran = r_time() - p->run_start;
+
+  if(p->on_rq)
+    panic("sched_run_end: queued");
+  p->cputime += ran;
+  policy->tick(p, ran);
+
+  // yield() is only called on a timer interrupt
+  __sync_fetch_and_add(&total.runtime, ran);
+  if(p->state == SLEEPING){
+    st->nvoluntary++;
+    __sync_fetch_and_add(&total.nvoluntary, 1);
+  } else if(p->state == RUNNABLE){
+    st->ninvoluntary++;
+    __sync_fetch_and_add(&total.ninvoluntary, 1);
+  }
+}
+
+// Start the statistics of a new process from zero.
+// Caller must hold p->lock.
+void
+sched_stats_reset(struct proc *p)
+{
+  memset(&stats[p - proc], 0, sizeof(stats[0]));
+}
+
+// Copy the statistics of p, or of the whole system if p is 0, to *st.
+// Caller must hold p->lock.
+void
+sched_stats_get(struct proc *p, struct sched_stats *st)
+{
+  if(p == 0){
+    // Not a consistent snapshot: the counters can move while copied
+    *st = total;
+    st->pid = 0;
+    st->ps_priority = 0;
+    safestrcpy(st->name, "total", sizeof(st->name));
+    return;
+  }
+  *st = stats[p - proc];
+  st->pid = p->pid;
+  st->ps_priority = p->ps_priority;
+  safestrcpy(st->name, p->name, sizeof(st->name));
+  st->runtime = p->cputime;
+}
+
+// ex4 priority inheritance. The priority p runs at: its own, or the
+// one it inherited from a process waiting for a lock it holds if that
+// is higher (lower ps_priority).
+int
+sched_priority(struct proc *p)
+{
+  if(p->boost_priority != 0 && p->boost_priority < p->ps_priority)
+    return p->boost_priority;
+  return p->ps_priority;
+}
+
+// waiter, the current process, is about to sleep on a lock p holds.
+// p runs at waiter's priority until sched_unboost(), and gets a key
+// no later than waiter's, so the policy picks it no later than it
+// would have picked waiter. The key is only lent: p->boost_credit
+// keeps how far it moved, for sched_unboost() to charge back.
+// Round robin has no keys to lower.
+// Caller must hold p->lock.
+void
+sched_boost(struct proc *p, struct proc *waiter)
+{
+  struct runq *rq = &runqs[p->cpu];
+  int prio = sched_priority(waiter);
+  long long key;
+
+  if(prio < sched_priority(p))
+    p->boost_priority = prio;
+
+  // A queued process stays on the queue of p->cpu
+  acquire(&rq->lock);
+  if(policy->boost != 0 && p->sched_gen == policy_gen && waiter->sched_gen == policy_gen &&
+     (key = policy->key(waiter)) < policy->key(p)){
+    if(p->on_rq){
+      rq->n--;
+      policy->dequeue(rq, p);
+    }
+    if(p->boost_gen != policy_gen){
+      p->boost_credit = 0;
+      p->boost_gen = policy_gen;
+    }
+    p->boost_credit += policy->key(p) - key;
+    policy->boost(p, key);
+    if(p->on_rq){
+      rq->n++;
+      policy->enqueue(rq, p);
+      runq_update_min(rq);
+    }
+  }
+  release(&rq->lock);
+}
+
+// p let go of a lock. prio is the highest priority still waiting for
+// the locks it holds, or 0 if none. Once nobody waits, p pays back
+// the key it was lent, unless it got a fresh one since.
+// Caller must hold p->lock.
+void
+sched_unboost(struct proc *p, int prio)
+{
+  struct runq *rq = &runqs[p->cpu];
+
+  p->boost_priority = prio;
+  if(prio != 0 || p->boost_credit == 0)
+    return;
+
+  acquire(&rq->lock);
+  if(p->boost_gen == policy_gen && p->sched_gen == policy_gen){
+    if(p->on_rq){
+      rq->n--;
+      policy->dequeue(rq, p);
+    }
+    policy->boost(p, policy->key(p) + p->boost_credit);
+    if(p->on_rq){
+      rq->n++;
+      policy->enqueue(rq, p);
+      runq_update_min(rq);
+    }
+  }
+  p->boost_credit = 0;
+  release(&rq->lock);
+}
+
+// Switch to another policy. Every queue is emptied and filled again
+// under the new policy, which gives the queued processes fresh keys;
+// the running and sleeping ones get theirs when they are queued.
+// Returns the previous policy, or -1 if id is not a policy.
+int
+sched_set_policy(int id)
+{
+  static struct proc *moving[NPROC];  // only used with every run queue lock held
+  struct runq *rq;
+  struct proc *p;
+  int old, n = 0, i;
+
+  if(id < 0 || id >= NSCHED)
+    return -1;
+
+  for(rq = runqs; rq < &runqs[NCPU]; rq++)
+    acquire(&rq->lock);
+
+  old = policy_id;
+  if(id != old){
+    for(rq = runqs; rq < &runqs[NCPU]; rq++){
+      while((p = policy->pick_next(rq)) != 0){
+        rq->n--;
+        policy->dequeue(rq, p);
+        p->on_rq = 0;
+        moving[n++] = p;
+      }
+    }
+
+    policy_id = id;
+    policy = &policies[id];
+    policy_gen++;
+
+    // A queued process stays on the queue of p->cpu, and p->cpu
+    // doesn't change while it is queued.
+    for(i = 0; i < n; i++){
+      p = moving[i];
+      rq = &runqs[p->cpu];
+      policy->place(p, PLACE_NEW);
+      p->sched_gen = policy_gen;
+      p->sched_place = PLACE_NONE;
+      rq->n++;
+      policy->enqueue(rq, p);
+      p->on_rq = 1;
+    }
+    for(rq = runqs; rq < &runqs[NCPU]; rq++)
+      runq_update_min(rq);
+  }
+
+  for(rq = runqs; rq < &runqs[NCPU]; rq++)
+    release(&rq->lock);
+  return old;
+}
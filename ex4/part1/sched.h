@@ -0,0 +1,24 @@
+// ex4 scheduling policies, for set_sched_policy().
+#define SCHED_RR          0   // round robin
+#define SCHED_ACCUMULATOR 1   // lowest accumulator first, the default
+#define SCHED_CFS         2   // lowest weighted virtual runtime first
+#define NSCHED            3
+
+// ex4 scheduling statistics, see get_sched_stats().
+// Times are in time CSR units, QUANTUM_TIME of them per tick.
+#define NSCHEDHIST   16       // latency histogram buckets
+#define SCHEDHIST_MIN 1024    // upper bound of bucket 0, doubling per bucket
+
+struct sched_stats {
+  int pid;                    // 0 for the whole system
+  int ps_priority;
+  char name[16];
+  uint64 runtime;             // time spent RUNNING
+  uint64 waittime;            // time spent RUNNABLE
+  uint64 nswitch;             // times switched in
+  uint64 nvoluntary;          // times it gave up the CPU to sleep
+  uint64 ninvoluntary;        // times the timer took the CPU away
+  // RUNNABLE to RUNNING latencies: bucket i counts the ones below
+  // SCHEDHIST_MIN << i, the last bucket all the longer ones.
+  uint64 latency[NSCHEDHIST];
+};
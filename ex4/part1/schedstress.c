@@ -0,0 +1,111 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// ex4 scheduler stress test.
+// Runs pairs of processes that bounce a byte over a pair of pipes, so
+// every round trip is two sleeps, two wakeups and two context switches.
+// Run it with a different number of harts to see how scheduling
+// throughput scales, e.g. make qemu CPUS=1 ... make qemu CPUS=8.
+//
+// usage: schedstress [pairs] [ticks]
+
+#define DEFAULT_PAIRS 8
+#define DEFAULT_TICKS 50
+#define CHECK_EVERY 64    // round trips between two uptime() calls
+
+// Bounce bytes back until a zero byte comes in.
+void
+ponger(int in, int out)
+{
+  char b;
+
+  while(read(in, &b, 1) == 1 && b != 0){
+    if(write(out, &b, 1) != 1)
+      break;
+  }
+  exit(0);
+}
+
+// Bounce bytes off the ponger until the deadline, then report
+// the number of round trips on the result pipe.
+void
+pinger(int in, int out, int result, int deadline)
+{
+  int rounds = 0;
+  char b = 1;
+
+  for(;;){
+    if(rounds % CHECK_EVERY == 0 && uptime() >= deadline)
+      break;
+    if(write(out, &b, 1) != 1 || read(in, &b, 1) != 1){
+      printf("schedstress: FAIL pipe\n");
+      exit(1);
+    }
+    rounds++;
+  }
+  b = 0;
+  write(out, &b, 1);
+  write(result, &rounds, sizeof(rounds));
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pairs = argc > 1 ? atoi(argv[1]) : DEFAULT_PAIRS;
+  int ticks = argc > 2 ? atoi(argv[2]) : DEFAULT_TICKS;
+  int result[2];
+  int i, start, elapsed, rounds, total;
+
+  if(pairs < 1 || ticks < 1){
+    printf("usage: schedstress [pairs] [ticks]\n");
+    exit(1);
+  }
+  if(pipe(result) < 0){
+    printf("schedstress: FAIL pipe\n");
+    exit(1);
+  }
+
+  start = uptime();
+  for(i = 0; i < pairs; i++){
+    int ping[2], pong[2];
+
+    if(pipe(ping) < 0 || pipe(pong) < 0){
+      printf("schedstress: FAIL pipe\n");
+      exit(1);
+    }
+    if(fork() == 0){
+      close(ping[1]);
+      close(pong[0]);
+      ponger(ping[0], pong[1]);
+    }
+    if(fork() == 0){
+      close(ping[0]);
+      close(pong[1]);
+      pinger(pong[0], ping[1], result[1], start + ticks);
+    }
+    close(ping[0]);
+    close(ping[1]);
+    close(pong[0]);
+    close(pong[1]);
+  }
+
+  total = 0;
+  for(i = 0; i < pairs; i++){
+    if(read(result[0], &rounds, sizeof(rounds)) != sizeof(rounds)){
+      printf("schedstress: FAIL lost a result\n");
+      exit(1);
+    }
+    total += rounds;
+  }
+  for(i = 0; i < 2 * pairs; i++)
+    wait(0);
+  elapsed = uptime() - start;
+  if(elapsed < 1)
+    elapsed = 1;
+
+  printf("schedstress: %d pairs, %d round trips in %d ticks\n", pairs, total, elapsed);
+  printf("schedstress: %d context switches per tick\n", 2 * total / elapsed);
+  exit(0);
+}
@@ -0,0 +1,86 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// ex4 scheduler statistics viewer.
+// Usage: schedtop [rounds [ticks between rounds]]
+// Every round prints the scheduling statistics of every process and
+// the system-wide histogram of RUNNABLE to RUNNING latencies.
+// Times are shown in 1/1000 tick.
+
+#define QUANTUM_TIME 1000000   // time CSR units per tick, see start.c
+
+int
+ms(uint64 t)
+{
+  return (int)(t * 1000 / QUANTUM_TIME);
+}
+
+void
+print_stats(struct sched_stats *st)
+{
+  printf("%d\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\n",
+         st->pid, st->ps_priority, st->name, ms(st->runtime), ms(st->waittime),
+         st->nswitch ? ms(st->waittime / st->nswitch) : 0,
+         (int)st->nswitch, (int)st->nvoluntary, (int)st->ninvoluntary);
+}
+
+void
+print_round(void)
+{
+  struct sched_stats st;
+  int pid, last, b;
+
+  // There is no process list, but every live pid is at most the
+  // one the kernel hands out next
+  if((last = fork()) == 0)
+    exit(0);
+  if(last < 0){
+    printf("schedtop: fork failed\n");
+    exit(1);
+  }
+  wait(0);
+
+  printf("pid\tprio\tname\trun\twait\tavgwait\tswitch\tvol\tinvol\n");
+  for(pid = 1; pid < last; pid++)
+    if(get_sched_stats(pid, &st) == 0)
+      print_stats(&st);
+  if(get_sched_stats(0, &st) < 0){
+    printf("schedtop: get_sched_stats failed\n");
+    exit(1);
+  }
+  print_stats(&st);
+
+  printf("latency (1/1000 tick)\tcount\n");
+  for(b = 0; b < NSCHEDHIST; b++){
+    if(st.latency[b] == 0)
+      continue;
+    if(b < NSCHEDHIST - 1)
+      printf("< %d\t\t\t%d\n", ms((uint64)SCHEDHIST_MIN << b), (int)st.latency[b]);
+    else
+      printf(">= %d\t\t\t%d\n", ms((uint64)SCHEDHIST_MIN << (b - 1)), (int)st.latency[b]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 1;
+  int ticks = argc > 2 ? atoi(argv[2]) : 10;
+  int i;
+
+  if(argc > 3 || rounds < 1 || ticks < 1){
+    printf("usage: schedtop [rounds [ticks between rounds]]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < rounds; i++){
+    if(i > 0){
+      sleep(ticks);
+      printf("\n");
+    }
+    print_round();
+  }
+  exit(0);
+}
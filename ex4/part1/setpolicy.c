@@ -0,0 +1,39 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// ex4: setpolicy rr|acc|cfs switches the scheduling policy of
+// every CPU and prints the one that was in use.
+
+char *names[NSCHED] = {
+  [SCHED_RR]          "rr",
+  [SCHED_ACCUMULATOR] "acc",
+  [SCHED_CFS]         "cfs",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int i, old;
+
+  if(argc != 2){
+    fprintf(2, "usage: setpolicy rr|acc|cfs\n");
+    exit(1);
+  }
+
+  for(i = 0; i < NSCHED; i++)
+    if(strcmp(argv[1], names[i]) == 0)
+      break;
+  if(i == NSCHED){
+    fprintf(2, "setpolicy: unknown policy %s\n", argv[1]);
+    exit(1);
+  }
+
+  if((old = set_sched_policy(i)) < 0){
+    fprintf(2, "setpolicy: set_sched_policy failed\n");
+    exit(1);
+  }
+  printf("%s -> %s\n", names[old], names[i]);
+  exit(0);
+}
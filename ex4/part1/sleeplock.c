@@ -0,0 +1,87 @@
+// Sleeping locks
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "sleeplock.h"
+
+void
+initsleeplock(struct sleeplock *lk, char *name)
+{
+  initlock(&lk->lk, "sleep lock");
+  lk->name = name;
+  lk->locked = 0;
+  lk->pid = 0;
+  lk->proc = 0;
+  lk->next_held = 0;
+}
+
+void
+acquiresleep(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+
+  acquire(&lk->lk);
+  while (lk->locked) {
+    // ex4: lend the holder our priority while we wait, so a
+    // lower priority holder can't keep us waiting for long
+    acquire(&lk->proc->lock);
+    sched_boost(lk->proc, p);
+    release(&lk->proc->lock);
+    sleep(lk, &lk->lk);
+  }
+  lk->locked = 1;
+  lk->pid = p->pid;
+  lk->proc = p;
+  lk->next_held = p->held;
+  p->held = lk;
+  release(&lk->lk);
+}
+
+void
+releasesleep(struct sleeplock *lk)
+{
+  struct proc *p = myproc();
+  struct sleeplock **pp;
+  int prio = 0, w;
+
+  acquire(&lk->lk);
+  for(pp = &p->held; *pp != 0; pp = &(*pp)->next_held){
+    if(*pp == lk){
+      *pp = lk->next_held;
+      break;
+    }
+  }
+  lk->locked = 0;
+  lk->pid = 0;
+  lk->proc = 0;
+  lk->next_held = 0;
+  wakeup(lk);
+  release(&lk->lk);
+
+  // ex4: keep only what is inherited through the locks still held
+  for(lk = p->held; lk != 0; lk = lk->next_held){
+    w = sleepers_priority(lk);
+    if(w != 0 && (prio == 0 || w < prio))
+      prio = w;
+  }
+  acquire(&p->lock);
+  sched_unboost(p, prio);
+  release(&p->lock);
+}
+
+int
+holdingsleep(struct sleeplock *lk)
+{
+  int r;
+  
+  acquire(&lk->lk);
+  r = lk->locked && (lk->pid == myproc()->pid);
+  release(&lk->lk);
+  return r;
+}
+
@@ -0,0 +1,14 @@
+// Long-term locks for processes
+struct sleeplock {
+  uint locked;       // Is the lock held?
+  struct spinlock lk; // spinlock protecting this sleep lock
+  
+  // For debugging:
+  char *name;        // Name of lock.
+  int pid;           // Process holding lock
+
+  // ex4 priority inheritance:
+  struct proc *proc;             // Process holding lock
+  struct sleeplock *next_held;   // Next lock in proc->held
+};
+
@@ -0,0 +1,89 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// ex4 timer wheel test.
+// Many processes sleep for different lengths at once, some long enough
+// to pass through the higher levels of the wheel. Each one must wake
+// up no earlier than its deadline and no more than SLACK ticks late.
+
+#define NSLEEPERS 20
+#define SLACK 2
+
+// Sleep with sleep() or sleep_until() and report how late the wakeup was.
+void
+sleeper(int i, int start)
+{
+  int deadline = start + 5 + i * 7;   // reaches past the first 64 ticks
+  int now;
+
+  if(i % 2 == 0){
+    if(sleep(deadline - uptime()) < 0)
+      exit(2);
+  } else {
+    if(sleep_until(deadline) < 0)
+      exit(2);
+  }
+  now = uptime();
+  if(now < deadline){
+    printf("sleeptest: FAIL sleeper %d woke at %d, deadline %d\n", i, now, deadline);
+    exit(1);
+  }
+  if(now > deadline + SLACK){
+    printf("sleeptest: FAIL sleeper %d woke at %d, %d ticks late\n", i, now, now - deadline);
+    exit(1);
+  }
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, status, failed = 0;
+  int start = uptime();
+  int before;
+
+  for(i = 0; i < NSLEEPERS; i++){
+    int pid = fork();
+    if(pid < 0){
+      printf("sleeptest: FAIL fork\n");
+      exit(1);
+    }
+    if(pid == 0)
+      sleeper(i, start);
+  }
+  for(i = 0; i < NSLEEPERS; i++){
+    wait(&status);
+    if(status != 0)
+      failed = 1;
+  }
+
+  // A deadline in the past must not block
+  before = uptime();
+  if(sleep_until(before - 5) != 0 || uptime() - before > 1){
+    printf("sleeptest: FAIL sleep_until in the past blocked\n");
+    failed = 1;
+  }
+
+  // A killed sleeper must come back early
+  int pid = fork();
+  if(pid == 0){
+    sleep(1000);
+    exit(0);
+  }
+  sleep(2);
+  before = uptime();
+  kill(pid);
+  wait(0);
+  if(uptime() - before > SLACK){
+    printf("sleeptest: FAIL killed sleeper kept sleeping\n");
+    failed = 1;
+  }
+
+  if(failed){
+    printf("sleeptest: FAIL\n");
+    exit(1);
+  }
+  printf("sleeptest: PASS\n");
+  exit(0);
+}
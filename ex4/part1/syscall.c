@@ -103,6 +103,10 @@ extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
 
 extern uint64 sys_set_ps_priority(void);
+extern uint64 sys_sleep_until(void);
+extern uint64 sys_get_cputime(void);
+extern uint64 sys_set_sched_policy(void);
+extern uint64 sys_get_sched_stats(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -130,6 +134,10 @@ static uint64 (*syscalls[])(void) = {
 [SYS_close]   sys_close,
 
 [SYS_set_ps_priority] sys_set_ps_priority,
+[SYS_sleep_until]     sys_sleep_until,
+[SYS_get_cputime]     sys_get_cputime,
+[SYS_set_sched_policy] sys_set_sched_policy,
+[SYS_get_sched_stats]  sys_get_sched_stats,
 };
 
 void
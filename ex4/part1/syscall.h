@@ -21,4 +21,8 @@
 #define SYS_mkdir  20
 #define SYS_close  21
 
-#define SYS_set_ps_priority 22
\ No newline at end of file
+#define SYS_set_ps_priority 22
+#define SYS_sleep_until     23
+#define SYS_get_cputime     24
+#define SYS_set_sched_policy 25
+#define SYS_get_sched_stats  26
\ No newline at end of file
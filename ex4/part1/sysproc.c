@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 
 uint64
 sys_exit(void)
@@ -40,32 +41,47 @@ sys_sbrk(void)
 {
   uint64 addr;
   int n;
+  struct proc *p = myproc();
 
   argint(0, &n);
-  addr = myproc()->sz;
-  if(growproc(n) < 0)
+  addr = p->sz;
+  if(n > 0){
+    // ex4: only reserve the memory, usertrap() and copyin()/copyout()
+    // allocate a page when it is first touched
+    if(addr + n > TRAPFRAME)
+      return -1;
+    p->sz += n;
+  } else if(growproc(n) < 0){
     return -1;
+  }
   return addr;
 }
 
 uint64
 sys_sleep(void)
 {
-  int n;
-  uint ticks0;
+  int n, ret;
 
   argint(0, &n);
+  if(n < 0)
+    n = 0;
   acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
-    if(killed(myproc())){
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
+  ret = timer_sleep(ticks + n);
   release(&tickslock);
-  return 0;
+  return ret;
+}
+
+// ex4: sleep until the given absolute tick.
+uint64
+sys_sleep_until(void)
+{
+  int deadline, ret;
+
+  argint(0, &deadline);
+  acquire(&tickslock);
+  ret = timer_sleep((uint)deadline);
+  release(&tickslock);
+  return ret;
 }
 
 uint64
@@ -108,4 +124,50 @@ sys_set_ps_priority(void)
   release(&p->lock);
 
   return 0;
+}
+
+// ex4: get_cputime(pid, &time) copies the CPU time the process
+// has used, in time CSR units, to time.
+uint64
+sys_get_cputime(void)
+{
+  int pid;
+  uint64 addr, time;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(get_cputime(pid, &time) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char *)&time, sizeof(time)) < 0)
+    return -1;
+  return 0;
+}
+
+// ex4: set_sched_policy(policy) switches every CPU to one of the
+// SCHED_* policies in sched.h. Returns the previous policy.
+uint64
+sys_set_sched_policy(void)
+{
+  int policy;
+
+  argint(0, &policy);
+  return sched_set_policy(policy);
+}
+
+// ex4: get_sched_stats(pid, &stats) copies the scheduling statistics
+// of a process, or of the whole system if pid is 0, to stats.
+uint64
+sys_get_sched_stats(void)
+{
+  int pid;
+  uint64 addr;
+  struct sched_stats st;
+
+  argint(0, &pid);
+  argaddr(1, &addr);
+  if(get_sched_stats(pid, &st) < 0)
+    return -1;
+  if(copyout(myproc()->pagetable, addr, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
 }
\ No newline at end of file
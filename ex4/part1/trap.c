@@ -9,6 +9,23 @@
 struct spinlock tickslock;
 uint ticks;
 
+// in start.c; timervec sets timer_scratch[hart][6] for a tick.
+extern uint64 timer_scratch[NCPU][7];
+
+// ex4 timer wheel: armed timers hang off TIMER_LEVELS rings of
+// TIMER_SLOTS slots. Level l holds timers due in less than
+// TIMER_SLOTS^(l+1) ticks, hashed by their deadline. On every tick
+// only the current level-0 slot fires; a higher-level slot is spread
+// over the lower levels when the levels below it wrap around.
+// So a sleeping process is woken up once, when its deadline is due,
+// instead of on every tick. Protected by tickslock.
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_LEVELS 4
+#define TIMER_MAX_DELTA ((1U << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)
+
+struct timer *timer_wheel[TIMER_LEVELS][TIMER_SLOTS];
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -29,6 +46,105 @@ trapinithart(void)
   w_stvec((uint64)kernelvec);
 }
 
+// Arm t. Caller must hold tickslock.
+static void
+timer_insert(struct timer *t)
+{
+  uint delta = t->deadline - ticks;
+  uint when = t->deadline;
+  int level = 0;
+
+  // A deadline that is already due only comes from re-hashing
+  // inside timer_tick(), it goes to the current slot, which is
+  // expired right after. Deadlines too far away are parked at
+  // the farthest point and re-hashed when they get there.
+  if((int)delta < 0)
+    delta = 0, when = ticks;
+  if(delta > TIMER_MAX_DELTA)
+    delta = TIMER_MAX_DELTA, when = ticks + TIMER_MAX_DELTA;
+  while(level < TIMER_LEVELS - 1 && delta >= (1U << (TIMER_SLOT_BITS * (level + 1))))
+    level++;
+
+  struct timer **slot = &timer_wheel[level][(when >> (TIMER_SLOT_BITS * level)) % TIMER_SLOTS];
+  t->next = *slot;
+  if(t->next)
+    t->next->pprev = &t->next;
+  t->pprev = slot;
+  *slot = t;
+}
+
+// Disarm t if it is armed. Caller must hold tickslock.
+static void
+timer_cancel(struct timer *t)
+{
+  if(t->pprev == 0)
+    return;
+  *t->pprev = t->next;
+  if(t->next)
+    t->next->pprev = t->pprev;
+  t->next = 0;
+  t->pprev = 0;
+}
+
+// Advance the wheel to the current tick and wake up
+// everything that is due. Caller must hold tickslock.
+static void
+timer_tick(void)
+{
+  struct timer *t, *next;
+  int level;
+
+  // A level's slot is spread over the lower levels once every
+  // level below it wrapped. Higher levels go first so their
+  // timers can land in a lower slot that is handled next.
+  for(level = TIMER_LEVELS - 1; level > 0; level--){
+    if(ticks % (1U << (TIMER_SLOT_BITS * level)) != 0)
+      continue;
+    struct timer **slot = &timer_wheel[level][(ticks >> (TIMER_SLOT_BITS * level)) % TIMER_SLOTS];
+    t = *slot;
+    *slot = 0;
+    for(; t; t = next){
+      next = t->next;
+      timer_insert(t);
+    }
+  }
+
+  t = timer_wheel[0][ticks % TIMER_SLOTS];
+  timer_wheel[0][ticks % TIMER_SLOTS] = 0;
+  for(; t; t = next){
+    next = t->next;
+    t->next = 0;
+    t->pprev = 0;
+    if((int)(t->deadline - ticks) > 0)
+      timer_insert(t);   // parked far away, not due yet
+    else
+      wakeup(t->chan);
+  }
+}
+
+// Sleep until ticks reaches deadline.
+// Caller must hold tickslock, which is held again on return.
+// Returns 0, or -1 if the process was killed.
+int
+timer_sleep(uint deadline)
+{
+  struct proc *p = myproc();
+  struct timer *t = &p->timer;
+
+  t->deadline = deadline;
+  t->chan = t;
+  while((int)(deadline - ticks) > 0){
+    if(killed(p)){
+      timer_cancel(t);
+      return -1;
+    }
+    if(t->pprev == 0)
+      timer_insert(t);
+    sleep(t->chan, &tickslock);
+  }
+  return 0;
+}
+
 //
 // handle an interrupt, exception, or system call from user space.
 // called from trampoline.S
@@ -67,6 +183,11 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if((r_scause() == 13 || r_scause() == 15) &&
+            uvmlazy(p->pagetable, r_stval(), p->sz) == 0){
+    // ex4: first touch of a heap page since sbrk()
+  } else if(r_scause() == 15 && uvmcow(p->pagetable, r_stval()) == 0){
+    // ex4: first write to a copy-on-write page since fork
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -77,14 +198,9 @@ usertrap(void)
     exit(-1);
 
   // give up the CPU if this is a timer interrupt.
-if(which_dev == 2) {
-    // Charge the process for using a full quantum
-    struct proc *p = myproc();
-    if(p && p->state == RUNNING) { // Safety check
-        p->accumulator += p->ps_priority;
-    }
+  // The scheduler charges the time the process really ran.
+  if(which_dev == 2)
     yield();
-  }
 
   usertrapret();
 }
@@ -171,7 +287,7 @@ clockintr()
 {
   acquire(&tickslock);
   ticks++;
-  wakeup(&ticks);
+  timer_tick();
   release(&tickslock);
 }
 
@@ -209,16 +325,22 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
+    // or a kick, forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
+    // ex4: a kick only wakes this CPU up and is not a tick.
+    // timervec can set the flag again at any instruction, so
+    // take it with a single amoswap.
+    if(__atomic_exchange_n(&timer_scratch[cpuid()][6], 0, __ATOMIC_RELAXED) == 0)
+      return 1;
+
+    if(cpuid() == 0){
+      clockintr();
+    }
+
     return 2;
   } else {
     return 0;
@@ -1,4 +1,5 @@
 struct stat;
+struct sched_stats;
 
 // system calls
 int fork(void);
@@ -41,4 +42,8 @@ int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 
 // ex4
-int set_ps_priority(int);
\ No newline at end of file
+int set_ps_priority(int);
+int sleep_until(int);
+int get_cputime(int, uint64*);
+int set_sched_policy(int);
+int get_sched_stats(int, struct sched_stats*);
\ No newline at end of file
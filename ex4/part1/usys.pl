@@ -38,4 +38,8 @@ entry("sleep");
 entry("uptime");
 
 # ex4
-entry("set_ps_priority");
\ No newline at end of file
+entry("set_ps_priority");
+entry("sleep_until");
+entry("get_cputime");
+entry("set_sched_policy");
+entry("get_sched_stats");
\ No newline at end of file
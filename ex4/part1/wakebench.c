@@ -0,0 +1,156 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// ex4 wakeup benchmark.
+// A pair of processes bounces a byte over two pipes while a growing
+// number of idle processes sleep on channels of their own. Every round
+// trip is two wakeups. With wait queues the cost of a wakeup must not
+// depend on how many others are asleep.
+// The round trips per tick are counted here; the context switches and
+// the mean RUNNABLE to RUNNING latency come from the system-wide
+// get_sched_stats() while the pair bounces.
+//
+// usage: wakebench [ticks per run]
+
+#define DEFAULT_TICKS 20
+#define CHECK_EVERY 64    // round trips between two uptime() calls
+#define TICK_USEC 100000  // QEMU timer interval: 1000000 cycles at 10 MHz
+#define QUANTUM_TIME 1000000   // time CSR units per tick, see start.c
+
+struct result {
+  int rounds;             // round trips done
+  uint64 nswitch;         // context switches, system-wide
+  uint64 waittime;        // time spent RUNNABLE, system-wide
+};
+
+int sleeper_counts[] = { 0, 16, 32, 48 };
+#define NRUNS (sizeof(sleeper_counts) / sizeof(sleeper_counts[0]))
+
+// Sleep forever on a pipe nobody writes to, until killed.
+void
+idle_sleeper(void)
+{
+  int fds[2];
+  char b;
+
+  if(pipe(fds) < 0)
+    exit(1);
+  read(fds[0], &b, 1);
+  exit(0);
+}
+
+// Bounce bytes back until a zero byte comes in.
+void
+ponger(int in, int out)
+{
+  char b;
+
+  while(read(in, &b, 1) == 1 && b != 0){
+    if(write(out, &b, 1) != 1)
+      break;
+  }
+  exit(0);
+}
+
+// Fetch the system-wide scheduling statistics.
+void
+total_stats(struct sched_stats *st)
+{
+  if(get_sched_stats(0, st) < 0){
+    printf("wakebench: FAIL get_sched_stats\n");
+    exit(1);
+  }
+}
+
+// Run one measurement of ticks ticks with the given number of idle
+// sleepers.
+void
+run(int sleepers, int ticks, struct result *r)
+{
+  int pids[64];
+  int ping[2], pong[2];
+  int i, rounds, deadline;
+  struct sched_stats before, after;
+  char b = 1;
+
+  for(i = 0; i < sleepers; i++){
+    if((pids[i] = fork()) == 0)
+      idle_sleeper();
+    if(pids[i] < 0){
+      printf("wakebench: FAIL fork\n");
+      exit(1);
+    }
+  }
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf("wakebench: FAIL pipe\n");
+    exit(1);
+  }
+  if(fork() == 0){
+    close(ping[1]);
+    close(pong[0]);
+    ponger(ping[0], pong[1]);
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  // let the sleepers reach their read() first
+  sleep(2);
+
+  rounds = 0;
+  total_stats(&before);
+  deadline = uptime() + ticks;
+  for(;;){
+    if(rounds % CHECK_EVERY == 0 && uptime() >= deadline)
+      break;
+    if(write(ping[1], &b, 1) != 1 || read(pong[0], &b, 1) != 1){
+      printf("wakebench: FAIL pipe\n");
+      exit(1);
+    }
+    rounds++;
+  }
+  total_stats(&after);
+  r->rounds = rounds;
+  r->nswitch = after.nswitch - before.nswitch;
+  r->waittime = after.waittime - before.waittime;
+  b = 0;
+  write(ping[1], &b, 1);
+  close(ping[1]);
+  close(pong[0]);
+  wait(0);
+
+  for(i = 0; i < sleepers; i++)
+    kill(pids[i]);
+  for(i = 0; i < sleepers; i++)
+    wait(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = argc > 1 ? atoi(argv[1]) : DEFAULT_TICKS;
+  struct result r;
+  int i;
+
+  if(ticks < 1){
+    printf("usage: wakebench [ticks per run]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < NRUNS; i++){
+    run(sleeper_counts[i], ticks, &r);
+    printf("wakebench: %d sleepers: %d round trips in %d ticks, %d per tick, ",
+           sleeper_counts[i], r.rounds, ticks, r.rounds / ticks);
+    if(r.rounds > 0)
+      printf("%d us per round trip, ", ticks * TICK_USEC / r.rounds);
+    printf("%d context switches, ", (int)r.nswitch);
+    if(r.nswitch > 0)
+      printf("%d us mean RUNNABLE to RUNNING\n",
+             (int)(r.waittime * TICK_USEC / QUANTUM_TIME / r.nswitch));
+    else
+      printf("no switches\n");
+  }
+  exit(0);
+}